@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+// Replacement of the global operator new counting the allocations of every thread, linked only in the
+// executables built with PYLON_COUNT_ALLOCATIONS. It covers the pylon and YARP libraries too, the
+// over-aligned allocations and the plain malloc calls are not counted.
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "pylonHeapCounter.h"
+
+namespace
+{
+// Constant initialized, usable by the allocations made while a thread starts or exits
+thread_local std::uint64_t allocations{0};
+
+void* allocate(std::size_t size)
+{
+    ++allocations;
+    if (size == 0)
+    {
+        size = 1;
+    }
+    while (true)
+    {
+        void* memory = std::malloc(size);
+        if (memory != nullptr)
+        {
+            return memory;
+        }
+        auto handler = std::get_new_handler();
+        if (handler == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void* allocateNoThrow(std::size_t size) noexcept
+{
+    try
+    {
+        return allocate(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+}  // namespace
+
+std::uint64_t pylonHeapCounter::threadAllocations() noexcept
+{
+    return allocations;
+}
+
+void* operator new(std::size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocateNoThrow(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocateNoThrow(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+    std::free(memory);
+}
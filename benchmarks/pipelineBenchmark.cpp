@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+// Camera-free benchmarks of the stages of the pylonCamera acquisition pipeline, on synthetic frames
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if defined WITH_PYLON_CONVERTER
+#include <pylon/PylonIncludes.h>
+#endif  // WITH_PYLON_CONVERTER
+
+#include "pylonImageKernels.h"
+
+namespace
+{
+struct resolution
+{
+    size_t width;
+    size_t height;
+};
+
+// Production resolutions, see the suggested resolutions of the README
+const std::array<resolution, 3> resolutions{{{640, 480}, {1024, 768}, {1920, 1080}}};
+const std::array<double, 4> rotations{0.0, 90.0, -90.0, 180.0};
+const std::array<pylonImageKernels::simdLevel, 4> simdLevels{pylonImageKernels::simdLevel::none, pylonImageKernels::simdLevel::ssse3, pylonImageKernels::simdLevel::avx2,
+                                                             pylonImageKernels::simdLevel::neon};
+
+std::vector<std::uint8_t> syntheticFrame(size_t size)
+{
+    std::vector<std::uint8_t> frame(size);
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    for (auto& byte : frame)
+    {
+        byte = static_cast<std::uint8_t>(distribution(generator));
+    }
+    return frame;
+}
+
+void setFrameCounters(benchmark::State& state, size_t output_bytes)
+{
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * output_bytes));
+    state.counters["fps"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+void BM_BayerToRgb(benchmark::State& state)
+{
+    auto level = simdLevels[state.range(0)];
+    auto res = resolutions[state.range(1)];
+    auto kernel = pylonImageKernels::bayerToRgbKernel(level);
+    if (kernel == nullptr)
+    {
+        state.SkipWithError("instruction set not available");
+        return;
+    }
+    state.SetLabel(pylonImageKernels::simdLevelName(level));
+    auto src = syntheticFrame(res.width * res.height);
+    std::vector<std::uint8_t> dst(res.width * res.height * 3);
+    for (auto _ : state)
+    {
+        kernel(src.data(), res.width, dst.data(), res.width * 3, res.width, res.height, pylonImageKernels::bayerPattern::RG);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setFrameCounters(state, dst.size());
+}
+
+void BM_Yuv422ToRgb(benchmark::State& state)
+{
+    auto level = simdLevels[state.range(0)];
+    auto res = resolutions[state.range(1)];
+    auto kernel = pylonImageKernels::yuv422ToRgbKernel(level);
+    if (kernel == nullptr)
+    {
+        state.SkipWithError("instruction set not available");
+        return;
+    }
+    state.SetLabel(pylonImageKernels::simdLevelName(level));
+    auto src = syntheticFrame(res.width * res.height * 2);
+    std::vector<std::uint8_t> dst(res.width * res.height * 3);
+    for (auto _ : state)
+    {
+        kernel(src.data(), res.width * 2, dst.data(), res.width * 3, res.width, res.height);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setFrameCounters(state, dst.size());
+}
+
+#if defined WITH_PYLON_CONVERTER
+// The converter used with pixel_format default, for comparison with the host kernels
+void BM_PylonBayerToRgb(benchmark::State& state)
+{
+    auto res = resolutions[state.range(0)];
+    auto src = syntheticFrame(res.width * res.height);
+    std::vector<std::uint8_t> dst(res.width * res.height * 3);
+    Pylon::CImageFormatConverter converter;
+    converter.OutputPixelFormat = Pylon::PixelType_RGB8packed;
+    for (auto _ : state)
+    {
+        converter.Convert(dst.data(), dst.size(), src.data(), src.size(), Pylon::PixelType_BayerRG8, static_cast<uint32_t>(res.width), static_cast<uint32_t>(res.height), 0,
+                          Pylon::ImageOrientation_TopDown);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setFrameCounters(state, dst.size());
+}
+#endif  // WITH_PYLON_CONVERTER
+
+// The rotation left to the host: the full transform, or only the transpose when the sensor does the flips.
+// With rotation_with_crop the sensor area is the swapped one and the output has the requested resolution.
+template <size_t pixel_size>
+void BM_Rotation(benchmark::State& state)
+{
+    auto rotation = rotations[state.range(0)];
+    bool with_crop = state.range(1) != 0;
+    bool camera_flips = state.range(2) != 0;
+    auto res = resolutions[state.range(3)];
+    pylonImageKernels::orientation wanted;
+    pylonImageKernels::rotationOrientation(rotation, false, wanted);
+    if (camera_flips)
+    {
+        wanted.reverseRows = false;
+        wanted.reverseCols = false;
+    }
+    auto kernel = pixel_size == 3 ? pylonImageKernels::transformRgbKernel(wanted.transpose, wanted.reverseRows, wanted.reverseCols)
+                                  : pylonImageKernels::transformMonoKernel(wanted.transpose, wanted.reverseRows, wanted.reverseCols);
+    size_t src_width = with_crop && wanted.transpose ? res.height : res.width;
+    size_t src_height = with_crop && wanted.transpose ? res.width : res.height;
+    size_t dst_width = wanted.transpose ? src_height : src_width;
+    auto src = syntheticFrame(src_width * src_height * pixel_size);
+    std::vector<std::uint8_t> dst(src.size());
+    for (auto _ : state)
+    {
+        if (kernel != nullptr)
+        {
+            kernel(src.data(), src_width * pixel_size, dst.data(), dst_width * pixel_size, src_width, src_height);
+        }
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setFrameCounters(state, dst.size());
+}
+
+// The handoff from the acquisition thread to the caller of getImage()
+void BM_FinalCopy(benchmark::State& state)
+{
+    auto res = resolutions[state.range(0)];
+    auto src = syntheticFrame(res.width * res.height * 3);
+    std::vector<std::uint8_t> dst(src.size());
+    for (auto _ : state)
+    {
+        memcpy(dst.data(), src.data(), src.size());
+        benchmark::DoNotOptimize(dst.data());
+        benchmark::ClobberMemory();
+    }
+    setFrameCounters(state, dst.size());
+}
+
+void conversionArguments(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->ArgNames({"simd", "resolution"});
+    for (int64_t level = 0; level < static_cast<int64_t>(simdLevels.size()); ++level)
+    {
+        for (int64_t res = 0; res < static_cast<int64_t>(resolutions.size()); ++res)
+        {
+            benchmark->Args({level, res});
+        }
+    }
+}
+
+void resolutionArguments(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->ArgName("resolution");
+    for (int64_t res = 0; res < static_cast<int64_t>(resolutions.size()); ++res)
+    {
+        benchmark->Arg(res);
+    }
+}
+
+void rotationArguments(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->ArgNames({"rotation", "crop", "camera_flips", "resolution"});
+    for (int64_t rotation = 0; rotation < static_cast<int64_t>(rotations.size()); ++rotation)
+    {
+        for (int64_t crop = 0; crop < 2; ++crop)
+        {
+            for (int64_t flips = 0; flips < 2; ++flips)
+            {
+                for (int64_t res = 0; res < static_cast<int64_t>(resolutions.size()); ++res)
+                {
+                    benchmark->Args({rotation, crop, flips, res});
+                }
+            }
+        }
+    }
+}
+}  // namespace
+
+BENCHMARK(BM_BayerToRgb)->Apply(conversionArguments);
+BENCHMARK(BM_Yuv422ToRgb)->Apply(conversionArguments);
+#if defined WITH_PYLON_CONVERTER
+BENCHMARK(BM_PylonBayerToRgb)->Apply(resolutionArguments);
+#endif  // WITH_PYLON_CONVERTER
+BENCHMARK_TEMPLATE(BM_Rotation, 3)->Apply(rotationArguments);
+BENCHMARK_TEMPLATE(BM_Rotation, 1)->Apply(rotationArguments);
+BENCHMARK(BM_FinalCopy)->Apply(resolutionArguments);
+
+int main(int argc, char** argv)
+{
+#if defined WITH_PYLON_CONVERTER
+    Pylon::PylonAutoInitTerm pylon_runtime;
+#endif  // WITH_PYLON_CONVERTER
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+// End-to-end soak of pylonCameraDriver against the pylon camera emulator (no hardware needed).
+// A consumer thread reads the images at the requested fps while the control threads
+// write and read the features, as the frameGrabber_nws_yarp rpc does.
+
+#include <yarp/os/Network.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/Time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#if defined __unix__
+#include <unistd.h>
+#endif  // __unix__
+
+#include "pylonCameraDriver.h"
+#include "pylonLatencyHistogram.h"
+
+namespace
+{
+// Resident set size in KiB, 0 where it cannot be read
+std::uint64_t residentSetSize()
+{
+#if defined __unix__
+    std::ifstream statm("/proc/self/statm");
+    std::uint64_t pages{0};
+    std::uint64_t resident{0};
+    if (statm >> pages >> resident)
+    {
+        return resident * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE)) / 1024;
+    }
+#endif  // __unix__
+    return 0;
+}
+
+struct soakCounters
+{
+    std::atomic<std::uint64_t> newFrames{0};
+    std::atomic<std::uint64_t> repeatedFrames{0};
+    std::atomic<std::uint64_t> droppedFrames{0};
+    std::atomic<std::uint64_t> failedReads{0};
+    std::atomic<std::uint64_t> failedControls{0};
+    pylonLatencyHistogram frameLatency;    // camera stamp to consumer
+    pylonLatencyHistogram getImageCall;    // getImage() duration
+    pylonLatencyHistogram controlCall;     // setFeature()/getFeature() duration
+};
+
+void printHistogram(const char* name, const pylonLatencyHistogram& histogram)
+{
+    printf("  %-12s count %10llu  p50 %10.1f us  p99 %10.1f us  p99.9 %10.1f us  max %10.1f us\n", name, static_cast<unsigned long long>(histogram.count()),
+           1e-3 * static_cast<double>(histogram.percentile(50.0)), 1e-3 * static_cast<double>(histogram.percentile(99.0)),
+           1e-3 * static_cast<double>(histogram.percentile(99.9)), 1e-3 * static_cast<double>(histogram.max()));
+}
+
+void printReport(const soakCounters& counters, double elapsed, std::uint64_t start_rss)
+{
+    auto rss = residentSetSize();
+    printf("[%8.1f s] fps %7.2f  new %llu  repeated %llu  dropped %llu  failed reads %llu  failed controls %llu  rss %llu KiB (%+lld KiB)\n", elapsed,
+           elapsed > 0.0 ? static_cast<double>(counters.newFrames) / elapsed : 0.0, static_cast<unsigned long long>(counters.newFrames),
+           static_cast<unsigned long long>(counters.repeatedFrames), static_cast<unsigned long long>(counters.droppedFrames),
+           static_cast<unsigned long long>(counters.failedReads), static_cast<unsigned long long>(counters.failedControls), static_cast<unsigned long long>(rss),
+           static_cast<long long>(rss) - static_cast<long long>(start_rss));
+    printHistogram("latency", counters.frameLatency);
+    printHistogram("getImage", counters.getImageCall);
+    printHistogram("controls", counters.controlCall);
+    fflush(stdout);
+}
+
+void consumerLoop(pylonCameraDriver& driver, double fps, const std::atomic<bool>& running, soakCounters& counters)
+{
+    yarp::sig::ImageOf<yarp::sig::PixelRgb> image;
+    int last_count{-1};
+    double period = 1.0 / fps;
+    double next = yarp::os::Time::now();
+    while (running)
+    {
+        auto start = pylonLatencyHistogram::now();
+        bool ok = driver.getImage(image);
+        counters.getImageCall.record(pylonLatencyHistogram::now() - start);
+        if (!ok)
+        {
+            ++counters.failedReads;
+        }
+        else if (!driver.isLastImageNew())
+        {
+            ++counters.repeatedFrames;
+        }
+        else
+        {
+            // The stamp counts every frame grabbed by the driver, the gaps are the frames the consumer never saw
+            auto stamp = driver.getLastInputStamp();
+            if (last_count >= 0 && stamp.getCount() > last_count + 1)
+            {
+                counters.droppedFrames += static_cast<std::uint64_t>(stamp.getCount() - last_count - 1);
+            }
+            last_count = stamp.getCount();
+            ++counters.newFrames;
+            double latency = yarp::os::Time::now() - stamp.getTime();
+            if (latency > 0.0)
+            {
+                counters.frameLatency.record(static_cast<std::uint64_t>(latency * 1e9));
+            }
+        }
+        next += period;
+        yarp::os::Time::delay(next - yarp::os::Time::now());
+    }
+}
+
+void controlLoop(pylonCameraDriver& driver, size_t index, double rate, const std::atomic<bool>& running, soakCounters& counters)
+{
+    const std::vector<cameraFeature_id_t> features{YARP_FEATURE_GAIN, YARP_FEATURE_EXPOSURE, YARP_FEATURE_FRAME_RATE, YARP_FEATURE_BRIGHTNESS};
+    std::vector<cameraFeature_id_t> available;
+    for (auto feature : features)
+    {
+        bool has_feature{false};
+        if (driver.hasFeature(feature, &has_feature) && has_feature)
+        {
+            available.push_back(feature);
+        }
+    }
+    if (available.empty())
+    {
+        return;
+    }
+    // Even threads write the gain back and forth, the others only read
+    bool writer = index % 2 == 0;
+    double gain{0.0};
+    driver.getFeature(YARP_FEATURE_GAIN, &gain);
+    size_t iteration{0};
+    while (running)
+    {
+        bool ok{true};
+        auto start = pylonLatencyHistogram::now();
+        if (writer)
+        {
+            ok = driver.setFeature(YARP_FEATURE_GAIN, iteration % 2 == 0 ? 0.25 : gain);
+        }
+        else
+        {
+            double value{0.0};
+            ok = driver.getFeature(available[iteration % available.size()], &value);
+        }
+        counters.controlCall.record(pylonLatencyHistogram::now() - start);
+        if (!ok)
+        {
+            ++counters.failedControls;
+        }
+        ++iteration;
+        yarp::os::Time::delay(1.0 / rate);
+    }
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    yarp::os::Property options;
+    options.fromCommand(argc, argv);
+    if (options.check("help"))
+    {
+        printf("Options: --duration <minutes> --fps <fps> --width <px> --height <px> --rotation <0.0|90.0|-90.0|180.0> --rotation_with_crop <true|false>\n");
+        printf("         --pixel_format <name> --acquisition_mode <thread|sync|event> --control_threads <n> --control_rate <Hz> --report_period <s>\n");
+        printf("         --serial_number <sn> (default 0815-0000, the first emulated camera)\n");
+        return EXIT_SUCCESS;
+    }
+
+    double duration = options.check("duration", yarp::os::Value(10.0)).asFloat64() * 60.0;
+    double fps = options.check("fps", yarp::os::Value(30.0)).asFloat64();
+    auto control_threads = static_cast<size_t>(options.check("control_threads", yarp::os::Value(2)).asInt32());
+    double control_rate = options.check("control_rate", yarp::os::Value(50.0)).asFloat64();
+    double report_period = options.check("report_period", yarp::os::Value(10.0)).asFloat64();
+    if (fps <= 0.0 || control_rate <= 0.0 || report_period <= 0.0)
+    {
+        fprintf(stderr, "fps, control_rate and report_period must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    // The emulation transport layer has to be enabled before the pylon runtime starts
+#if defined _WIN32
+    _putenv_s("PYLON_CAMEMU", "1");
+#else
+    setenv("PYLON_CAMEMU", "1", 0);
+#endif  // _WIN32
+
+    yarp::os::Network yarp;
+    yarp::os::Property config;
+    config.put("serial_number", options.check("serial_number", yarp::os::Value("0815-0000")).asString());
+    config.put("width", options.check("width", yarp::os::Value(640)).asInt32());
+    config.put("height", options.check("height", yarp::os::Value(480)).asInt32());
+    config.put("period", 1.0 / fps);
+    config.put("rotation", options.check("rotation", yarp::os::Value(0.0)).asFloat64());
+    config.put("pixel_format", options.check("pixel_format", yarp::os::Value("default")).asString());
+    config.put("acquisition_mode", options.check("acquisition_mode", yarp::os::Value("thread")).asString());
+    if (options.check("rotation_with_crop"))
+    {
+        config.put("rotation_with_crop", options.find("rotation_with_crop"));
+    }
+
+    pylonCameraDriver driver;
+    if (!driver.open(config))
+    {
+        fprintf(stderr, "Cannot open the emulated camera with %s\n", config.toString().c_str());
+        driver.close();
+        return EXIT_FAILURE;
+    }
+
+    soakCounters counters;
+    std::atomic<bool> running{true};
+    auto start_rss = residentSetSize();
+    double start = yarp::os::Time::now();
+    std::thread consumer(consumerLoop, std::ref(driver), fps, std::cref(running), std::ref(counters));
+    std::vector<std::thread> controls;
+    for (size_t i = 0; i < control_threads; ++i)
+    {
+        controls.emplace_back(controlLoop, std::ref(driver), i, control_rate, std::cref(running), std::ref(counters));
+    }
+
+    // The first report period is the warm-up, the allocations are checked from its end
+    double elapsed{0.0};
+    bool warmed_up{false};
+    std::uint64_t warm_allocations{0};
+    std::uint64_t warm_frames{0};
+    while (elapsed < duration)
+    {
+        yarp::os::Time::delay(std::min(report_period, duration - elapsed));
+        elapsed = yarp::os::Time::now() - start;
+        printReport(counters, elapsed, start_rss);
+        if (!warmed_up)
+        {
+            warm_allocations = driver.getAllocationCount();
+            warm_frames = counters.newFrames;
+            warmed_up = true;
+        }
+    }
+    auto steady_allocations = driver.getAllocationCount() - warm_allocations;
+    auto steady_frames = counters.newFrames - warm_frames;
+
+    running = false;
+    consumer.join();
+    for (auto& control : controls)
+    {
+        control.join();
+    }
+    driver.close();
+
+    printf("Summary:\n");
+    printReport(counters, elapsed, start_rss);
+    printf("  heap allocations of the acquisition after the warm-up: %llu over %llu frames (%.3f per frame)\n", static_cast<unsigned long long>(steady_allocations),
+           static_cast<unsigned long long>(steady_frames), steady_frames > 0 ? static_cast<double>(steady_allocations) / static_cast<double>(steady_frames) : 0.0);
+    // A soak is failed by a consumer that cannot keep the requested rate, or by an acquisition allocating in steady state
+    bool passed = counters.newFrames > 0 && static_cast<double>(counters.newFrames) / elapsed >= 0.9 * fps;
+    if (!passed)
+    {
+        printf("FAILED: the sustained fps is below 90%% of the requested one\n");
+    }
+    else if (steady_allocations > 0)
+    {
+        printf("FAILED: the acquisition allocates in steady state\n");
+        passed = false;
+    }
+    else
+    {
+        printf("PASSED\n");
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
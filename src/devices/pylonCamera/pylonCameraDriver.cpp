@@ -8,13 +8,20 @@
 
 #include <opencv2/core/core_c.h>
 #include <yarp/cv/Cv.h>
+#include <yarp/os/Bottle.h>
+#include <yarp/os/ConnectionReader.h>
+#include <yarp/os/ConnectionWriter.h>
 #include <yarp/os/LogComponent.h>
+#include <yarp/os/Time.h>
 #include <yarp/os/Value.h>
 #include <yarp/sig/ImageUtils.h>
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
+#include <fstream>
+#include <future>
 #include <iomanip>
 #include <opencv2/opencv.hpp>
 #include <opencv2/videoio.hpp>
@@ -36,13 +43,24 @@ using namespace std;
 // 3 values, 2 is maximum and until now we always used blue and red in this order. Then we ignore
 // green
 
-static const std::vector<cameraFeature_id_t> supported_features{YARP_FEATURE_BRIGHTNESS, YARP_FEATURE_EXPOSURE, YARP_FEATURE_SHARPNESS, YARP_FEATURE_WHITE_BALANCE,
-                                                                // YARP_FEATURE_GAMMA, // it seems not writable
-                                                                YARP_FEATURE_GAIN,
-                                                                // YARP_FEATURE_TRIGGER, // not sure how to use it
-                                                                YARP_FEATURE_FRAME_RATE};
-
-static const std::vector<cameraFeature_id_t> features_with_auto{YARP_FEATURE_EXPOSURE, YARP_FEATURE_WHITE_BALANCE, YARP_FEATURE_GAIN};
+// Nodes behind each YARP feature, resolved once at open. A missing required node makes the open fail,
+// a missing optional one disables the feature (or its auto mode)
+struct featureNode
+{
+    cameraFeature_id_t feature;
+    const char* valueNode;
+    const char* autoNode;
+    bool required;
+};
+
+static constexpr featureNode featureTable[]{{YARP_FEATURE_BRIGHTNESS, "BslBrightness", nullptr, false},
+                                            {YARP_FEATURE_EXPOSURE, "ExposureTime", "ExposureAuto", true},
+                                            {YARP_FEATURE_SHARPNESS, "BslSharpnessEnhancement", nullptr, false},
+                                            {YARP_FEATURE_WHITE_BALANCE, "BalanceRatio", "BalanceWhiteAuto", false},
+                                            // {YARP_FEATURE_GAMMA, "Gamma", nullptr, false}, // it seems not writable
+                                            {YARP_FEATURE_GAIN, "Gain", "GainAuto", true},
+                                            // {YARP_FEATURE_TRIGGER, ...}, // not sure how to use it
+                                            {YARP_FEATURE_FRAME_RATE, "AcquisitionFrameRate", nullptr, true}};
 
 // Values taken from the balser documentation for da4200-30mci
 static const std::map<cameraFeature_id_t, std::pair<double, double>> featureMinMax{{YARP_FEATURE_BRIGHTNESS, {-1.0, 1.0}},
@@ -52,7 +70,70 @@ static const std::map<cameraFeature_id_t, std::pair<double, double>> featureMinM
                                                                                    //{YARP_FEATURE_GAMMA, {0.0, 4.0}},
                                                                                    {YARP_FEATURE_GAIN, {0.0, 33.06}}};
 
-static const std::map<double, int> rotationToCVRot{{90.0, ROTATE_90_CLOCKWISE}, {-90.0, ROTATE_90_COUNTERCLOCKWISE}, {180.0, ROTATE_180}};
+// pixel_format parameter -> PixelFormat node value, "default" leaves the camera format untouched and uses the pylon converter
+static const std::map<std::string, std::string> pixelFormatToNode{{"default", ""}, {"bayer_rg8", "BayerRG8"}, {"yuv422", "YCbCr422_8"}, {"mono8", "Mono8"}};
+
+// acquisition_profile parameter -> grab strategy, buffers and output queue size. The memory budget is set from buffer_memory
+static const std::map<std::string, pylonGrabSettings> acquisitionProfiles{{"low_latency", {GrabStrategy_UpcomingImage, 4, 1, 0}},
+                                                                          {"balanced", {GrabStrategy_LatestImages, 10, 1, 0}},
+                                                                          {"lossless", {GrabStrategy_OneByOne, 32, 1, 0}}};
+
+// Period of the latched timestamp samples for the clock synchronization
+static constexpr double timestampLatchPeriod{1.0};  // s
+// A retrieve waits for a few frame intervals before reporting a stall, plus the transfer of the frame
+static constexpr double retrieveTimeoutIntervals{3.0};
+static constexpr double retrieveTimeoutMargin{0.05};  // s
+// The first frame of a stream also waits for the sensor to start
+static constexpr double firstFrameTimeout{1.0};  // s
+// Period of the checks of the device removal and of the attempts to reopen a removed camera
+static constexpr double watchdogPeriod{1.0};  // s
+
+// Latch command and value nodes, USB and GigE cameras
+static const std::vector<std::pair<std::string, std::string>> timestampLatchNodes{{"TimestampLatch", "TimestampLatchValue"},
+                                                                                  {"GevTimestampControlLatch", "GevTimestampValue"}};
+
+// ChunkSelector entry -> chunk node in the chunk data of the frames
+static const std::vector<std::pair<std::string, std::string>> chunkNodes{{"ExposureTime", "ChunkExposureTime"},
+                                                                         {"Gain", "ChunkGain"},
+                                                                         {"FrameID", "ChunkFrameID"},
+                                                                         {"Timestamp", "ChunkTimestamp"}};
+
+// Boolean nodes enabled at startup when the model has them (the dart ones do, e.g. the emulated cameras do not)
+static const std::vector<const char*> optionalEnableNodes{"AcquisitionFrameRateEnable", "BslScalingEnable"};
+
+// Nodes locked by the camera while it is grabbing (they change the payload, its format or the whole configuration): writing them needs a
+// restart of the stream. Any other node that is not writable is locked by something else and the restart would not help
+static const std::vector<std::string> streamLockedNodes{"Width",
+                                                        "Height",
+                                                        "OffsetX",
+                                                        "OffsetY",
+                                                        "PixelFormat",
+                                                        "BinningHorizontal",
+                                                        "BinningVertical",
+                                                        "BinningHorizontalMode",
+                                                        "BinningVerticalMode",
+                                                        "DecimationHorizontal",
+                                                        "DecimationVertical",
+                                                        "BslScalingEnable",
+                                                        "BslScalingFactor",
+                                                        "ReverseX",
+                                                        "ReverseY",
+                                                        "ChunkModeActive",
+                                                        "ChunkEnable",
+                                                        "AcquisitionMode",
+                                                        "UserSetLoad",
+                                                        "UserSetSave"};
+
+// Nodes changing the orientation of the frames: the ones captured before the write must not be processed with the new host transform
+static const std::vector<std::string> frameFlushingNodes{"ReverseX", "ReverseY"};
+
+// Nodes whose value depends on a selector
+static const std::map<std::string, std::string> nodeToSelector{{"BalanceRatio", "BalanceRatioSelector"}};
+
+static const std::map<EPixelType, pylonImageKernels::bayerPattern> pixelTypeToBayerPattern{{PixelType_BayerRG8, pylonImageKernels::bayerPattern::RG},
+                                                                                           {PixelType_BayerGR8, pylonImageKernels::bayerPattern::GR},
+                                                                                           {PixelType_BayerGB8, pylonImageKernels::bayerPattern::GB},
+                                                                                           {PixelType_BayerBG8, pylonImageKernels::bayerPattern::BG}};
 
 // We usually set the features through a range between 0 an 1, we have to translate it in meaninful value for the camera
 double fromZeroOneToRange(cameraFeature_id_t feature, double value)
@@ -66,14 +147,27 @@ double fromRangeToZeroOne(cameraFeature_id_t feature, double value)
     return (value - featureMinMax.at(feature).first) / (featureMinMax.at(feature).second - featureMinMax.at(feature).first);
 }
 
-bool pylonCameraDriver::setFramerate(const float _fps)
+class pylonCameraDriver::removalHandler : public Pylon::CConfigurationEventHandler
 {
-    auto res = setOption("AcquisitionFrameRate", _fps);
-    if (res)
+   public:
+    explicit removalHandler(pylonCameraDriver& driver) : m_driver(driver)
     {
-        m_fps = _fps;
     }
-    return res;
+
+    void OnCameraDeviceRemoved(Pylon::CInstantCamera& camera) override
+    {
+        yCError(PYLON_CAMERA) << "Camera" << camera.GetDeviceInfo().GetSerialNumber() << "has been removed";
+        m_driver.deviceRemoved();
+    }
+
+   private:
+    pylonCameraDriver& m_driver;
+};
+
+bool pylonCameraDriver::setFramerate(const float _fps)
+{
+    // m_fps is updated when the write is applied (writeApplied), inside a transaction only by its commit
+    return setFeatureValue(YARP_FEATURE_FRAME_RATE, _fps);
 }
 
 bool parseUint32Param(std::string param_name, std::uint32_t& param, yarp::os::Searchable& config)
@@ -130,602 +224,2749 @@ bool parseBooleanParam(std::string param_name, bool& param, yarp::os::Searchable
     }
 }
 
-bool pylonCameraDriver::startCamera()
+size_t pylonCameraDriver::maxFrameSize() const
 {
     if (m_camera_ptr)
     {
-        if (!m_camera_ptr->IsGrabbing())
+        CIntegerParameter payload_size(m_camera_ptr->GetNodeMap(), "PayloadSize");
+        if (payload_size.IsReadable())
         {
-            m_camera_ptr->StartGrabbing(GrabStrategy_LatestImageOnly);
+            return static_cast<size_t>(payload_size.GetValue());
         }
     }
-    return true;
+    return static_cast<size_t>(m_sensorWidth) * m_sensorHeight * 4;
 }
 
-bool pylonCameraDriver::stopCamera()
+bool pylonCameraDriver::startCamera()
 {
-    if (m_camera_ptr)
+    if (m_recorder.isOpen())
     {
-        if (m_camera_ptr->IsGrabbing())
-        {
-            m_camera_ptr->StopGrabbing();
-        }
+        // The writes that restarted the stream can have changed the payload (e.g. Width, PixelFormat), the frames
+        // would not fit anymore in the slots of the recorder. They grow with the next frame, without waiting here
+        m_recorder.reserve(maxFrameSize());
     }
-    return true;
+    std::lock_guard<std::mutex> guard(m_streamMutex);
+    return startSources();
 }
 
-bool pylonCameraDriver::open(Searchable& config)
+bool pylonCameraDriver::startSources()
 {
     bool ok{true};
-    yCTrace(PYLON_CAMERA) << "input params are " << config.toString();
-    if (!config.check("serial_number"))
+    if (m_rightFrameSource)
     {
-        yCError(PYLON_CAMERA) << "serial_number parameter not specified";
-        return false;
+        ok = m_rightFrameSource->startGrabbing();
     }
-    // TODO understand how to treat it, if string or int
-    m_serial_number = config.find("serial_number").toString().c_str();
+    if (m_frameSource)
+    {
+        ok = m_frameSource->startGrabbing() && ok;
+    }
+    return ok;
+}
 
-    double period{0.03};
-    parseUint32Param("width", m_width, config);
-    parseUint32Param("height", m_height, config);
-    parseFloat64Param("period", period, config);
-    parseFloat64Param("rotation", m_rotation, config);
-    parseBooleanParam("rotation_with_crop", m_rotationWithCrop, config);
+bool pylonCameraDriver::stopCamera()
+{
+    // Stopping wakes a pending retrieve up, it has returned once the stream lock is taken. The sources are stopped
+    // again under it: that retrieve can have restarted a stereo pair in the meanwhile
+    stopSources();
+    std::lock_guard<std::mutex> guard(m_streamMutex);
+    stopSources();
+    return true;
+}
 
-    if (m_rotationWithCrop)
+void pylonCameraDriver::stopSources()
+{
+    if (m_frameSource)
     {
-        if (m_rotation == -90.0 || m_rotation == 90.0)
-        {
-            std::swap(m_width, m_height);
-        }
-        yCDebug(PYLON_CAMERA) << "Rotation with crop";
+        m_frameSource->stopGrabbing();
+    }
+    if (m_rightFrameSource)
+    {
+        m_rightFrameSource->stopGrabbing();
     }
+}
 
-    if (period != 0.0)
+GenApi::INode* pylonCameraDriver::getNode(const std::string& option) const
+{
+    if (!m_camera_ptr)
     {
-        m_fps = 1.0 / period;  // the fps has to be aligned with the nws period
+        return nullptr;
     }
+    return m_camera_ptr->GetNodeMap().GetNode(option.c_str());
+}
 
-    // Initialize pylon resources
-    PylonInitialize();
-    // Get factory singleton
-    CTlFactory& factory = CTlFactory::GetInstance();
-    yCDebug(PYLON_CAMERA) << "SERIAL NUMBER!" << m_serial_number << config.find("serial_number").asString();
-    // Open the device using the S/N
-    try
+bool pylonCameraDriver::isLockedWhileGrabbing(GenApi::INode* node)
+{
+    if (!m_camera_ptr || !m_camera_ptr->IsGrabbing())
     {
-        m_camera_ptr = std::make_unique<Pylon::CInstantCamera>(factory.CreateDevice(CDeviceInfo().SetSerialNumber(m_serial_number)));
-        if (m_camera_ptr)
+        return false;
+    }
+    // Not writable now, and known to be locked by the stream: a node locked by something else (e.g. ExposureTime while
+    // ExposureAuto is Continuous) stays locked after a restart
+    CParameter parameter(node);
+    if (!parameter.IsValid() || parameter.IsWritable())
+    {
+        return false;
+    }
+    return std::find(streamLockedNodes.begin(), streamLockedNodes.end(), std::string(node->GetName().c_str())) != streamLockedNodes.end();
+}
+
+bool pylonCameraDriver::flushesFrames(const std::string& option) const
+{
+    return m_frameSource && m_frameSource->isGrabbing() && std::find(frameFlushingNodes.begin(), frameFlushingNodes.end(), option) != frameFlushingNodes.end();
+}
+
+void pylonCameraDriver::writeApplied(const std::string& option, const yarp::os::Value& value)
+{
+    if (option == "ReverseX" || option == "ReverseY")
+    {
+        (option == "ReverseX" ? m_sensorReverseX : m_sensorReverseY) = value.asBool();
+        updateHostTransform();
+    }
+    else if (option == "AcquisitionFrameRate")
+    {
+        m_fps = static_cast<float>(value.asFloat64());
+    }
+    else if (option == "Width" || option == "Height")
+    {
+        setSensorSize(option == "Width" ? value.asInt32() : m_sensorWidth.load(), option == "Height" ? value.asInt32() : m_sensorHeight.load());
+    }
+}
+
+bool pylonCameraDriver::resolveFeatures()
+{
+    bool ok{true};
+    std::uint64_t valid_values{0};
+    std::uint64_t valid_auto_modes{0};
+    auto& node_map = m_camera_ptr->GetNodeMap();
+    for (const auto& entry : featureTable)
+    {
+        auto& handles = m_features[entry.feature];
+        handles.valueNode = entry.valueNode;
+        handles.autoNode = entry.autoNode;
+        if (!handles.value.Attach(node_map, entry.valueNode) || !handles.value.IsValid())
         {
-            m_camera_ptr->Open();
-            if (!m_camera_ptr->IsOpen())
+            if (entry.required)
             {
-                yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot be opened";
-                return false;
+                yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "has no" << entry.valueNode << "node, it is required";
+                ok = false;
+            }
+            else
+            {
+                yCWarning(PYLON_CAMERA) << "Camera" << m_serial_number << "has no" << entry.valueNode << "node, the feature" << entry.feature << "is disabled";
             }
+            handles.value.Release();
+            continue;
         }
-        else
+        if (entry.autoNode != nullptr && (!handles.autoMode.Attach(node_map, entry.autoNode) || !handles.autoMode.IsValid()))
         {
-            yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot be opened";
-            return false;
+            yCWarning(PYLON_CAMERA) << "Camera" << m_serial_number << "has no" << entry.autoNode << "node, the auto mode of" << entry.valueNode << "is disabled";
+            handles.autoMode.Release();
         }
+        valid_values |= std::uint64_t{1} << entry.feature;
+        valid_auto_modes |= static_cast<std::uint64_t>(handles.autoMode.IsValid()) << entry.feature;
     }
-    catch (const GenericException& e)
+    // The white balance ratios are behind a selector
+    auto& white_balance = m_features[YARP_FEATURE_WHITE_BALANCE];
+    if (white_balance.value.IsValid() && (!m_balanceRatioSelector.Attach(node_map, "BalanceRatioSelector") || !m_balanceRatioSelector.IsValid()))
     {
-        // Error handling.
-        yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot be opened, error:" << e.GetDescription();
-        return false;
+        yCWarning(PYLON_CAMERA) << "Camera" << m_serial_number << "has no BalanceRatioSelector node, the white balance is disabled";
+        white_balance.value.Release();
+        white_balance.autoMode.Release();
+        valid_values &= ~(std::uint64_t{1} << YARP_FEATURE_WHITE_BALANCE);
+        valid_auto_modes &= ~(std::uint64_t{1} << YARP_FEATURE_WHITE_BALANCE);
     }
-    // TODO get it from conf
-
-    auto& nodemap = m_camera_ptr->GetNodeMap();
-    // TODO maybe put in a try catch
-    ok = ok && setOption("AcquisitionFrameRateEnable", true);
-    ok = ok && setOption("BslScalingEnable", true);
-    ok = ok && setRgbResolution(m_width, m_height);
-
-    // TODO disabling it for testing the network, probably it is better to keep it as Auto
-    ok = ok && setOption("ExposureAuto", "Off", true);
-
-    ok = ok && setFramerate(m_fps);
+    m_validValues = valid_values;
+    m_validAutoModes = valid_auto_modes;
+    return ok;
+}
 
-    yCDebug(PYLON_CAMERA) << "Starting with this fps" << CFloatParameter(nodemap, "AcquisitionFrameRate").GetValue();
+bool pylonCameraDriver::setFeatureValue(cameraFeature_id_t feature, double value)
+{
+    auto* parameter = &m_features[feature].value;
+    return applyWrite(m_features[feature].valueNode, [parameter]() { return parameter->GetNode(); }, yarp::os::Value(value), [parameter, value](GenApi::INode*) {
+        parameter->SetValue(value);
+        return true;
+    });
+}
 
-#if defined USE_CUDA
-    yCDebug(PYLON_CAMERA) << "Using CUDA!";
-#else
-    yCDebug(PYLON_CAMERA) << "Not using CUDA!";
-#endif
+bool pylonCameraDriver::getFeatureValue(cameraFeature_id_t feature, double* value)
+{
+    auto& handles = m_features[feature];
+    yarp::os::Value cached;
+    if (readShadow(handles.valueNode, cached))
+    {
+        *value = cached.asFloat64();
+        return true;
+    }
+    try
+    {
+        // The handles are attached again by a reconnection, under the same lock
+        std::lock_guard<std::mutex> guard(m_mutex);
+        *value = handles.value.GetValue();
+        yCDebug(PYLON_CAMERA) << "Getting" << handles.valueNode << "value:" << *value;
+        writeShadow(handles.valueNode, yarp::os::Value(*value));
+    }
+    catch (const GenericException& e)
+    {
+        yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot get" << handles.valueNode << "error:" << e.GetDescription();
+        return false;
+    }
+    return true;
+}
 
-    return ok && startCamera();
+bool pylonCameraDriver::setAutoMode(cameraFeature_id_t feature, const char* mode)
+{
+    auto* parameter = &m_features[feature].autoMode;
+    std::string mode_value{mode};
+    return applyWrite(m_features[feature].autoNode, [parameter]() { return parameter->GetNode(); }, yarp::os::Value(mode_value), [parameter, mode_value](GenApi::INode*) {
+        parameter->SetValue(mode_value.c_str());
+        return true;
+    });
 }
 
-bool pylonCameraDriver::close()
+bool pylonCameraDriver::getAutoMode(cameraFeature_id_t feature, std::string& mode)
 {
-    if (m_camera_ptr->IsPylonDeviceAttached())
+    auto& handles = m_features[feature];
+    yarp::os::Value cached;
+    if (readShadow(handles.autoNode, cached))
+    {
+        mode = cached.asString();
+        return true;
+    }
+    try
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        mode = handles.autoMode.GetValue().c_str();
+        yCDebug(PYLON_CAMERA) << "Getting" << handles.autoNode << "value:" << mode;
+        writeShadow(handles.autoNode, yarp::os::Value(mode));
+    }
+    catch (const GenericException& e)
     {
-        m_camera_ptr->DetachDevice();
+        yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot get" << handles.autoNode << "error:" << e.GetDescription();
+        return false;
     }
-    // Releases all pylon resources.
-    PylonTerminate();
     return true;
 }
 
-int pylonCameraDriver::getRgbHeight()
+bool pylonCameraDriver::hasAutoMode(cameraFeature_id_t feature)
 {
-    return m_height;
+    return (m_validAutoModes >> feature) & 1U;
 }
 
-int pylonCameraDriver::getRgbWidth()
+bool pylonCameraDriver::selectBalanceRatio(const char* selector)
 {
-    return m_width;
+    auto* parameter = &m_balanceRatioSelector;
+    std::string entry{selector};
+    return applyWrite("BalanceRatioSelector", [parameter]() { return parameter->GetNode(); }, yarp::os::Value(entry), [parameter, entry](GenApi::INode*) {
+        parameter->SetValue(entry.c_str());
+        return true;
+    });
 }
 
-bool pylonCameraDriver::getRgbSupportedConfigurations(yarp::sig::VectorOf<CameraConfig>& configurations)
+void pylonCameraDriver::beginTransaction()
 {
-    yCWarning(PYLON_CAMERA) << "getRgbSupportedConfigurations not implemented yet";
-    return false;
+    beginTransaction("");
 }
 
-bool pylonCameraDriver::getRgbResolution(int& width, int& height)
+void pylonCameraDriver::beginTransaction(const std::string& rpc_source)
 {
-    width = m_width;
-    height = m_height;
-    return true;
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto& current = m_transactions[std::this_thread::get_id()];
+    current.marks.push_back(current.writes.size());
+    current.rpcSource = rpc_source;
 }
 
-bool pylonCameraDriver::setRgbResolution(int width, int height)
+bool pylonCameraDriver::commitTransaction()
 {
-    bool res = false;
-    if (width > 0 && height > 0)
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto current = m_transactions.find(std::this_thread::get_id());
+    if (current == m_transactions.end())
     {
-        res = setOption("Width", width);
-        res = res && setOption("Height", height);
-        if (res)
+        yCError(PYLON_CAMERA) << "No transaction to commit";
+        return false;
+    }
+    current->second.marks.pop_back();
+    if (!current->second.marks.empty())
+    {
+        return true;
+    }
+    auto pending = std::move(current->second.writes);
+    m_transactions.erase(current);
+    if (pending.empty())
+    {
+        return true;
+    }
+
+    // A single restart for the whole batch, and only if one of the nodes is locked while grabbing (or changes the frames in flight)
+    bool restart = std::any_of(pending.begin(), pending.end(), [this](const pendingWrite& write) { return isLockedWhileGrabbing(write.node) || flushesFrames(write.option); });
+    if (restart)
+    {
+        yCDebug(PYLON_CAMERA) << "The transaction contains nodes that cannot be written while grabbing, restarting the stream";
+        stopCamera();
+    }
+    bool ok{true};
+    // The writes are applied in order, a node can depend on the previous ones (e.g. selectors, enables)
+    for (const auto& write : pending)
+    {
+        try
+        {
+            if (write.write(write.node))
+            {
+                writeShadow(write.option, write.value);
+                ok = mirrorWrite(write.option, write.value) && ok;
+                writeApplied(write.option, write.value);
+            }
+            else
+            {
+                ok = false;
+            }
+        }
+        catch (const GenericException& e)
         {
-            m_width = width;
-            m_height = height;
+            yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot set" << write.option << "error:" << e.GetDescription();
+            ok = false;
         }
     }
-    return res;
-}
-
-bool pylonCameraDriver::setRgbFOV(double horizontalFov, double verticalFov)
-{
-    yCWarning(PYLON_CAMERA) << "setRgbFOV not supported";
-    return false;
+    yCDebug(PYLON_CAMERA) << "Committed" << pending.size() << "writes" << (restart ? "with a restart of the stream" : "without restarting the stream");
+    return (!restart || startCamera()) && ok;
 }
 
-bool pylonCameraDriver::getRgbFOV(double& horizontalFov, double& verticalFov)
+void pylonCameraDriver::abortTransaction()
 {
-    yCWarning(PYLON_CAMERA) << "getRgbFOV not supported";
-    return false;
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto current = m_transactions.find(std::this_thread::get_id());
+    if (current == m_transactions.end())
+    {
+        return;
+    }
+    // Only the writes queued since the matching begin are discarded, the outer levels are still committed
+    auto& levels = current->second;
+    levels.writes.erase(levels.writes.begin() + static_cast<std::ptrdiff_t>(levels.marks.back()), levels.writes.end());
+    levels.marks.pop_back();
+    if (levels.marks.empty())
+    {
+        m_transactions.erase(current);
+    }
 }
 
-bool pylonCameraDriver::getRgbMirroring(bool& mirror)
+void pylonCameraDriver::report(const yarp::os::PortInfo& info)
 {
-    yCWarning(PYLON_CAMERA) << "Mirroring not supported";
-    return false;
+    if (info.tag != yarp::os::PortInfo::PORTINFO_CONNECTION || !info.incoming || info.created)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for (auto it = m_transactions.begin(); it != m_transactions.end();)
+    {
+        if (!it->second.rpcSource.empty() && it->second.rpcSource == info.sourceName)
+        {
+            yCWarning(PYLON_CAMERA) << "The rpc connection from" << info.sourceName << "was closed inside a transaction, discarding its" << it->second.writes.size() << "writes";
+            it = m_transactions.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
 }
 
-bool pylonCameraDriver::setRgbMirroring(bool mirror)
+std::string pylonCameraDriver::shadowKey(const std::string& option, const std::string& selected_entry) const
 {
-    yCWarning(PYLON_CAMERA) << "Mirroring not supported";
-    return false;
+    auto selector = nodeToSelector.find(option);
+    if (selector == nodeToSelector.end())
+    {
+        return option;
+    }
+    if (!selected_entry.empty())
+    {
+        return option + "[" + selected_entry + "]";
+    }
+    auto selected = m_shadowRegisters.find(selector->second);
+    if (selected == m_shadowRegisters.end())
+    {
+        // The selected entry is not known, the value cannot be cached
+        return "";
+    }
+    return option + "[" + selected->second.asString() + "]";
 }
 
-bool pylonCameraDriver::getRgbIntrinsicParam(Property& intrinsic)
+bool pylonCameraDriver::readShadow(const std::string& option, yarp::os::Value& value, const std::string& selected_entry)
 {
-    yCWarning(PYLON_CAMERA) << "getRgbIntrinsicParam not implemented yet";
-    return false;
+    // The nodes changed by the camera itself while their auto function is running are not served from the shadow registers
+    for (const auto& entry : featureTable)
+    {
+        if (entry.autoNode != nullptr && option == entry.valueNode && hasAutoMode(entry.feature))
+        {
+            std::string mode;
+            if (!getAutoMode(entry.feature, mode) || mode != "Off")
+            {
+                return false;
+            }
+        }
+    }
+    std::lock_guard<std::mutex> guard(m_shadowMutex);
+    auto key = shadowKey(option, selected_entry);
+    auto cached = m_shadowRegisters.find(key);
+    if (key.empty() || cached == m_shadowRegisters.end())
+    {
+        return false;
+    }
+    value = cached->second;
+    return true;
 }
 
-bool pylonCameraDriver::getCameraDescription(CameraDescriptor* camera)
+void pylonCameraDriver::writeShadow(const std::string& option, const yarp::os::Value& value)
 {
-    yCWarning(PYLON_CAMERA) << "getCameraDescription not implemented yet";
-    return false;
+    std::lock_guard<std::mutex> guard(m_shadowMutex);
+    for (const auto& entry : featureTable)
+    {
+        if (entry.autoNode != nullptr && option == entry.autoNode)
+        {
+            // Switching the auto function leaves the controlled node to an unknown value
+            eraseShadow(entry.valueNode);
+            if (value.asString() == "Once")
+            {
+                // It goes back to Off by itself when it converges
+                eraseShadow(option);
+                return;
+            }
+        }
+    }
+    auto key = shadowKey(option);
+    if (!key.empty())
+    {
+        m_shadowRegisters[key] = value;
+    }
+    if (option == "ExposureTime")
+    {
+        m_exposureTime = value.asFloat64();
+    }
 }
 
-bool pylonCameraDriver::hasFeature(int feature, bool* hasFeature)
+void pylonCameraDriver::eraseShadow(const std::string& option)
 {
-    cameraFeature_id_t f;
-    f = static_cast<cameraFeature_id_t>(feature);
-    if (f < YARP_FEATURE_BRIGHTNESS || f > YARP_FEATURE_NUMBER_OF - 1)
+    auto prefix = option + "[";
+    for (auto it = m_shadowRegisters.begin(); it != m_shadowRegisters.end();)
     {
-        return false;
+        if (it->first == option || it->first.compare(0, prefix.size(), prefix) == 0)
+        {
+            it = m_shadowRegisters.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
     }
+}
 
-    *hasFeature = std::find(supported_features.begin(), supported_features.end(), f) != supported_features.end();
-
-    return true;
+void pylonCameraDriver::invalidateShadowRegisters()
+{
+    std::lock_guard<std::mutex> guard(m_shadowMutex);
+    m_shadowRegisters.clear();
 }
 
-bool pylonCameraDriver::setFeature(int feature, double value)
+bool pylonCameraDriver::setOptionFromValue(const std::string& option, const yarp::os::Value& value)
 {
-    bool b = false;
-    if (!hasFeature(feature, &b) || !b)
+    GenApi::EInterfaceType type;
     {
-        yCError(PYLON_CAMERA) << "Feature not supported!";
-        return false;
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto* node = getNode(option);
+        if (node == nullptr)
+        {
+            yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "has no" << option << "node";
+            return false;
+        }
+        type = node->GetPrincipalInterfaceType();
     }
-    b = false;
-    auto f = static_cast<cameraFeature_id_t>(feature);
-    switch (f)
+    switch (type)
     {
-        case YARP_FEATURE_BRIGHTNESS:
-            b = setOption("BslBrightness", fromZeroOneToRange(f, value));
-            break;
-        case YARP_FEATURE_EXPOSURE:
-            // According to https://www.kernel.org/doc/html/v4.8/media/uapi/v4l/extended-controls.html
-            // 1 unit = 100us, basler instead accept us. Setting directly in us.
-            b = setOption("ExposureTime", fromZeroOneToRange(f, value));
-            break;
-        case YARP_FEATURE_SHARPNESS:
-            b = setOption("BslSharpnessEnhancement", fromZeroOneToRange(f, value));
-            break;
-        case YARP_FEATURE_WHITE_BALANCE:
-            b = false;
-            yCError(PYLON_CAMERA) << "White balance require 2 values";
-            break;
-        case YARP_FEATURE_GAIN:
-            b = setOption("Gain", fromZeroOneToRange(f, value));
-            break;
-        case YARP_FEATURE_FRAME_RATE:
-            b = setFramerate(value);
-            break;
+        case GenApi::intfIFloat:
+            return setOption(option, value.asFloat64());
+        case GenApi::intfIInteger:
+            return setOption(option, value.asInt32());
+        case GenApi::intfIBoolean:
+            return setOption(option, value.asBool());
+        case GenApi::intfIEnumeration:
+            return setOption(option, value.asString().c_str(), true);
+        case GenApi::intfIString:
+            return setOption(option, value.asString().c_str());
         default:
-            yCError(PYLON_CAMERA) << "Feature not supported!";
+            yCError(PYLON_CAMERA) << "Node" << option << "has a type not supported";
             return false;
     }
+}
 
-    return b;
+bool pylonCameraDriver::mirrorWrite(const std::string& option, const yarp::os::Value& value)
+{
+    if (!m_rightCamera_ptr)
+    {
+        return true;
+    }
+    // Same model on both sides: the node is the same, its string form fits any type
+    CParameter parameter(m_rightCamera_ptr->GetNodeMap(), option.c_str());
+    if (!parameter.IsValid())
+    {
+        yCError(PYLON_CAMERA) << "Right camera" << m_rightSerialNumber << "has no" << option << "node";
+        return false;
+    }
+    parameter.FromString(value.toString().c_str());
+    return true;
 }
 
-bool pylonCameraDriver::getFeature(int feature, double* value)
+bool pylonCameraDriver::read(yarp::os::ConnectionReader& connection)
 {
-    bool b = false;
-    if (!hasFeature(feature, &b) || !b)
+    Bottle command;
+    Bottle reply;
+    if (!command.read(connection))
     {
-        yCError(PYLON_CAMERA) << "Feature not supported!";
         return false;
     }
-    b = false;
-    auto f = static_cast<cameraFeature_id_t>(feature);
-    switch (f)
+    auto cmd = command.get(0).asString();
+    bool ok{false};
+    // The nodes are read and written through pylon, a missing device (e.g. while reconnecting) throws
+    try
     {
-        case YARP_FEATURE_BRIGHTNESS:
-            b = getOption("BslBrightness", value);
-            break;
-        case YARP_FEATURE_EXPOSURE:
-            b = getOption("ExposureTime", value);
-            break;
-        case YARP_FEATURE_SHARPNESS:
-            b = getOption("BslSharpnessEnhancement", value);
-            break;
-        case YARP_FEATURE_WHITE_BALANCE:
-            b = false;
-            yCError(PYLON_CAMERA) << "White balance is a 2-values feature";
-            break;
-        case YARP_FEATURE_GAIN:
-            b = getOption("Gain", value);
-            break;
-        case YARP_FEATURE_FRAME_RATE:
-            b = true;
-            *value = m_fps;
-            break;
-        default:
-            yCError(PYLON_CAMERA) << "Feature not supported!";
+        if (cmd == "set" && command.size() == 3)
+        {
+            ok = setOptionFromValue(command.get(1).asString(), command.get(2));
+        }
+        else if (cmd == "get" && command.size() == 2)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            CParameter parameter(getNode(command.get(1).asString()));
+            ok = parameter.IsValid() && parameter.IsReadable();
+            if (ok)
+            {
+                reply.addString("ok");
+                reply.addString(parameter.ToString().c_str());
+            }
+        }
+        else if (cmd == "save" && command.size() <= 2)
+        {
+            auto target = command.size() == 2 ? command.get(1).asString() : (m_featureFile.empty() ? m_userSet : m_featureFile);
+            if (target.empty())
+            {
+                yCError(PYLON_CAMERA) << "No feature_file or user_set configured, use save <file.pfs> or save <user set>";
+            }
+            else
+            {
+                ok = saveCameraSettings(target);
+            }
+        }
+        else if (cmd == "begin")
+        {
+            // The reader thread is owned by the connection, the transaction is discarded if it is closed before the commit
+            beginTransaction(connection.getRemoteContact().getName());
+            ok = true;
+        }
+        else if (cmd == "commit")
+        {
+            ok = commitTransaction();
+        }
+        else if (cmd == "stats" && command.size() == 1)
+        {
+            reply.addString("ok");
+            fillStats(reply);
+            ok = true;
+        }
+        else if (cmd == "stats" && command.get(1).asString() == "reset")
+        {
+            resetStats();
+            ok = true;
+        }
+        else if (cmd == "refresh")
+        {
+            invalidateShadowRegisters();
+            ok = true;
+        }
+        else if (cmd == "abort")
+        {
+            abortTransaction();
+            ok = true;
+        }
+        else if (cmd == "help")
+        {
+            reply.addString("set <node> <value>: write a node of the camera");
+            reply.addString("get <node>: read a node of the camera");
+            reply.addString("begin: start a transaction, the next set are queued");
+            reply.addString("commit: apply the queued set with at most one restart of the stream");
+            reply.addString("abort: discard the queued set");
+            reply.addString("save [<file.pfs> | <user set>]: save the current camera settings, to the configured feature_file or user_set if not given");
+            reply.addString("refresh: drop the cached values of the nodes, the next reads go to the camera");
+            reply.addString("stats: fps, frame counters (also over the last stats_window s), failures by error code, per-stage latencies and skew of the stereo pairs (count p50 p99 max, us) since the last reset");
+            reply.addString("stats reset: restart the statistics");
+            ok = true;
+        }
+        else
+        {
+            yCError(PYLON_CAMERA) << "Unknown rpc command" << command.toString();
+        }
+    }
+    catch (const GenericException& e)
+    {
+        yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot execute" << command.toString() << "error:" << e.GetDescription();
+        ok = false;
+    }
+    if (reply.size() == 0)
+    {
+        reply.addString(ok ? "ok" : "fail");
+    }
+    else if (!ok)
+    {
+        reply.clear();
+        reply.addString("fail");
+    }
+    auto* writer = connection.getWriter();
+    if (writer != nullptr)
+    {
+        reply.write(*writer);
+    }
+    return true;
+}
+
+bool pylonCameraDriver::open(Searchable& config)
+{
+    bool ok{true};
+    yCTrace(PYLON_CAMERA) << "input params are " << config.toString();
+    std::string replay_file{""};
+    if (config.check("replay_file"))
+    {
+        parseStringParam("replay_file", replay_file, config);
+    }
+    else if (!config.check("serial_number"))
+    {
+        yCError(PYLON_CAMERA) << "serial_number parameter not specified";
+        return false;
+    }
+    // TODO understand how to treat it, if string or int
+    m_serial_number = config.check("serial_number") ? config.find("serial_number").toString().c_str() : replay_file.c_str();
+    if (config.check("right_serial_number"))
+    {
+        if (!replay_file.empty())
+        {
+            yCError(PYLON_CAMERA) << "right_serial_number cannot be used with replay_file";
             return false;
+        }
+        m_rightSerialNumber = config.find("right_serial_number").toString().c_str();
+        m_stereo = true;
     }
 
-    *value = fromRangeToZeroOne(f, *value);
-    yCDebug(PYLON_CAMERA) << "In 0-1" << *value;
-    return b;
+    double period{0.03};
+    std::uint32_t width{m_sensorWidth};
+    std::uint32_t height{m_sensorHeight};
+    parseUint32Param("width", width, config);
+    parseUint32Param("height", height, config);
+    parseFloat64Param("period", period, config);
+    parseFloat64Param("rotation", m_rotation, config);
+    parseBooleanParam("rotation_with_crop", m_rotationWithCrop, config);
+    bool chunk_metadata{true};
+    parseBooleanParam("chunk_metadata", chunk_metadata, config);
+    std::string pixel_format{"default"};
+    parseStringParam("pixel_format", pixel_format, config);
+    if (pixelFormatToNode.find(pixel_format) == pixelFormatToNode.end())
+    {
+        yCError(PYLON_CAMERA) << "pixel_format" << pixel_format << "not supported, allowed values: default, bayer_rg8, yuv422, mono8";
+        return false;
+    }
+    if (config.check("feature_file") && config.check("user_set"))
+    {
+        yCError(PYLON_CAMERA) << "feature_file and user_set cannot be used together";
+        return false;
+    }
+    if (config.check("feature_file"))
+    {
+        parseStringParam("feature_file", m_featureFile, config);
+    }
+    if (config.check("user_set"))
+    {
+        parseStringParam("user_set", m_userSet, config);
+    }
+    std::string acquisition_mode{"thread"};
+    parseStringParam("acquisition_mode", acquisition_mode, config);
+    if (acquisition_mode == "thread")
+    {
+        m_acquisitionMode = acquisitionMode::thread;
+    }
+    else if (acquisition_mode == "sync")
+    {
+        m_acquisitionMode = acquisitionMode::sync;
+    }
+    else if (acquisition_mode == "event")
+    {
+        // The frames are pushed by a single camera
+        if (m_stereo || !replay_file.empty())
+        {
+            yCError(PYLON_CAMERA) << "acquisition_mode event is not available with a stereo pair or a replay";
+            return false;
+        }
+        m_acquisitionMode = acquisitionMode::event;
+    }
+    else
+    {
+        yCError(PYLON_CAMERA) << "acquisition_mode" << acquisition_mode << "not supported, allowed values: thread, sync, event";
+        return false;
+    }
+
+    std::string acquisition_profile{"balanced"};
+    parseStringParam("acquisition_profile", acquisition_profile, config);
+    auto profile = acquisitionProfiles.find(acquisition_profile);
+    if (profile == acquisitionProfiles.end())
+    {
+        yCError(PYLON_CAMERA) << "acquisition_profile" << acquisition_profile << "not supported, allowed values: low_latency, balanced, lossless";
+        return false;
+    }
+    m_grabSettings = profile->second;
+    std::uint32_t buffer_memory{128};
+    parseUint32Param("buffer_memory", buffer_memory, config);
+    // The budget is for the whole device, the cameras of a stereo pair share it
+    m_grabSettings.memoryBudget = static_cast<size_t>(buffer_memory) * 1024 * 1024 / (m_stereo ? 2 : 1);
+    std::uint32_t stats_window{10};
+    parseUint32Param("stats_window", stats_window, config);
+    if (stats_window < 1 || stats_window > pylonFrameCounters::maxWindow)
+    {
+        yCError(PYLON_CAMERA) << "stats_window" << stats_window << "not supported, allowed values: from 1 to" << pylonFrameCounters::maxWindow << "s";
+        return false;
+    }
+    m_frameCounters.setWindow(stats_window);
+    bool reconnect{true};
+    parseBooleanParam("reconnect", reconnect, config);
+
+    pylonImageKernels::orientation rotation_orientation;
+    if (!pylonImageKernels::rotationOrientation(m_rotation, false, rotation_orientation))
+    {
+        yCError(PYLON_CAMERA) << "rotation" << m_rotation << "not supported, allowed values: 0.0, 90.0, -90.0, 180.0";
+        return false;
+    }
+
+    if (m_rotationWithCrop)
+    {
+        if (m_rotation == -90.0 || m_rotation == 90.0)
+        {
+            std::swap(width, height);
+        }
+        yCDebug(PYLON_CAMERA) << "Rotation with crop";
+    }
+    setSensorSize(width, height);
+
+    if (period != 0.0)
+    {
+        m_fps = 1.0 / period;  // the fps has to be aligned with the nws period
+    }
+
+    // Initialize pylon resources, shared with the other devices of the process
+    m_runtime = pylonRuntime::acquire();
+    if (!replay_file.empty())
+    {
+        bool replay_loop{true};
+        parseBooleanParam("replay_loop", replay_loop, config);
+        ok = openReplay(replay_file, replay_loop);
+    }
+    else
+    {
+        m_config.fromString(config.toString());
+        m_pixelFormat = pixel_format;
+        m_chunkMetadata = chunk_metadata;
+        ok = openCamera(config, pixel_format, chunk_metadata);
+    }
+    if (!ok)
+    {
+        return false;
+    }
+    setupClockSync(m_camera_ptr.get(), *m_frameSource, m_clock);
+    if (m_stereo)
+    {
+        setupClockSync(m_rightCamera_ptr.get(), *m_rightFrameSource, m_rightClock);
+    }
+
+    std::string record_file{""};
+    if (parseStringParam("record_file", record_file, config))
+    {
+        if (m_stereo)
+        {
+            yCError(PYLON_CAMERA) << "record_file does not support stereo pairs";
+            return false;
+        }
+        std::uint32_t record_buffer_frames{32};
+        bool record_direct_io{false};
+        parseUint32Param("record_buffer_frames", record_buffer_frames, config);
+        parseBooleanParam("record_direct_io", record_direct_io, config);
+        // The frames are recorded as they arrive, before any conversion: the payload is their size
+        if (!m_recorder.open(record_file, record_buffer_frames, maxFrameSize(), record_direct_io, m_frameSource->tickPeriod(), m_serial_number.c_str()))
+        {
+            return false;
+        }
+    }
+
+#if defined USE_CUDA
+    yCDebug(PYLON_CAMERA) << "Using CUDA!";
+#else
+    yCDebug(PYLON_CAMERA) << "Not using CUDA!";
+#endif
+
+    // All the per-frame resources are created once here, the acquisition does not allocate anymore
+    // The rotation is channel agnostic, the frame can be converted in RGB in any case
+    m_formatConverter.OutputPixelFormat = PixelType_RGB8packed;
+    m_monoConverter.OutputPixelFormat = PixelType_Mono8;
+    auto simd_level = pylonImageKernels::bestSimdLevel();
+    m_bayerToRgb = pylonImageKernels::bayerToRgbKernel(simd_level);
+    m_yuv422ToRgb = pylonImageKernels::yuv422ToRgbKernel(simd_level);
+    if (m_hostConversion)
+    {
+        yCInfo(PYLON_CAMERA) << "Converting" << (replay_file.empty() ? pixel_format : "the recorded frames") << "on the host using" << pylonImageKernels::simdLevelName(simd_level) << "kernels";
+    }
+    allocateBuffers();
+
+    std::string metadata_port{""};
+    if (parseStringParam("metadata_port", metadata_port, config) && !m_metadataPort.open(metadata_port))
+    {
+        yCError(PYLON_CAMERA) << "Cannot open the metadata port" << metadata_port;
+        return false;
+    }
+
+    std::string rpc_port{""};
+    if (parseStringParam("rpc_port", rpc_port, config))
+    {
+        m_rpcPort.setReader(*this);
+        m_rpcPort.setReporter(*this);
+        if (!m_rpcPort.open(rpc_port))
+        {
+            yCError(PYLON_CAMERA) << "Cannot open the rpc port" << rpc_port;
+            return false;
+        }
+    }
+
+    resetStats();
+    // In event mode the frames are processed by the grab thread of pylon as soon as they arrive
+    m_grabThreadRunning = m_acquisitionMode == acquisitionMode::event;
+    ok = ok && startCamera();
+    if (ok && m_acquisitionMode == acquisitionMode::thread)
+    {
+        m_grabThreadRunning = true;
+        m_grabThread = std::thread(&pylonCameraDriver::grabLoop, this);
+    }
+    if (ok && reconnect && m_camera_ptr)
+    {
+        for (auto* camera : cameras())
+        {
+            m_removalHandlers.push_back(std::make_unique<removalHandler>(*this));
+            camera->RegisterConfiguration(m_removalHandlers.back().get(), Pylon::RegistrationMode_Append, Pylon::Cleanup_None);
+        }
+        m_watchdogRunning = true;
+        m_watchdog = std::thread(&pylonCameraDriver::watchdogLoop, this);
+    }
+    return ok;
 }
 
-bool pylonCameraDriver::setFeature(int feature, double value1, double value2)
+bool pylonCameraDriver::openCamera(yarp::os::Searchable& config, const std::string& pixel_format, bool chunk_metadata)
 {
-    auto f = static_cast<cameraFeature_id_t>(feature);
-    if (f != YARP_FEATURE_WHITE_BALANCE)
+    bool ok{true};
+    yCDebug(PYLON_CAMERA) << "SERIAL NUMBER!" << m_serial_number << config.find("serial_number").asString();
+    // The right camera of a pair is opened at the same time, the slowest one gives the open time
+    std::future<bool> right_opened;
+    if (m_stereo)
+    {
+        right_opened = std::async(std::launch::async, &pylonCameraDriver::openRightCamera, this);
+    }
+    // Open the device using the S/N
+    try
+    {
+        m_camera_ptr = std::make_unique<Pylon::CInstantCamera>(m_runtime->createDevice(m_serial_number));
+        if (m_camera_ptr)
+        {
+            m_camera_ptr->Open();
+            if (!m_camera_ptr->IsOpen())
+            {
+                yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot be opened";
+                return false;
+            }
+        }
+        else
+        {
+            yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot be opened";
+            return false;
+        }
+    }
+    catch (const GenericException& e)
+    {
+        // Error handling.
+        yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot be opened, error:" << e.GetDescription();
+        return false;
+    }
+    // TODO get it from conf
+
+    if (!resolveFeatures())
     {
-        yCError(PYLON_CAMERA) << YARP_FEATURE_WHITE_BALANCE << "is not a 2-values feature supported";
         return false;
     }
-
-    auto res = setOption("BalanceRatioSelector", "Blue", true);
-    res = res && setOption("BalanceRatio", fromZeroOneToRange(f, value1));
-    res = res && setOption("BalanceRatioSelector", "Red", true);
-    res = res && setOption("BalanceRatio", fromZeroOneToRange(f, value2));
-    return res;
-}
-
-bool pylonCameraDriver::getFeature(int feature, double* value1, double* value2)
-{
-    auto f = static_cast<cameraFeature_id_t>(feature);
-    if (f != YARP_FEATURE_WHITE_BALANCE)
+    // The right camera is opened before any write, from now on it gets all of them
+    if (m_stereo)
+    {
+        if (!right_opened.get())
+        {
+            return false;
+        }
+        if (m_rightCamera_ptr->GetDeviceInfo().GetModelName() != m_camera_ptr->GetDeviceInfo().GetModelName())
+        {
+            yCWarning(PYLON_CAMERA) << "The cameras of the pair are different models," << m_camera_ptr->GetDeviceInfo().GetModelName() << "and"
+                                    << m_rightCamera_ptr->GetDeviceInfo().GetModelName() << "- some writes may not apply to both";
+        }
+    }
+    bool chunks_enabled{false};
+    ok = configureCamera(config, pixel_format, chunk_metadata, chunks_enabled);
+
+    auto camera_source = std::make_unique<pylonCameraSource>(*m_camera_ptr);
+    camera_source->setChunksEnabled(chunks_enabled);
+    camera_source->setGrabSettings(m_grabSettings);
+    if (m_acquisitionMode == acquisitionMode::event)
+    {
+        camera_source->setFrameHandler([this](bool succeeded, const pylonFrame& frame) { frameGrabbed(succeeded, frame); });
+    }
+    m_frameSource = std::move(camera_source);
+    if (m_stereo)
+    {
+        auto right_source = std::make_unique<pylonCameraSource>(*m_rightCamera_ptr);
+        right_source->setChunksEnabled(chunks_enabled);
+        right_source->setGrabSettings(m_grabSettings);
+        m_rightFrameSource = std::move(right_source);
+    }
+    return ok;
+}
+
+bool pylonCameraDriver::configureCamera(yarp::os::Searchable& config, const std::string& pixel_format, bool chunk_metadata, bool& chunks_enabled)
+{
+    bool ok{true};
+    auto& nodemap = m_camera_ptr->GetNodeMap();
+    // A persisted configuration replaces the defaults, only the parameters given explicitly are written on top of it
+    bool settings_loaded{false};
+    if (!loadCameraSettings(settings_loaded))
+    {
+        return false;
+    }
+    // All the startup writes are applied together
+    beginTransaction();
+    // TODO maybe put in a try catch
+    for (const auto& node : optionalEnableNodes)
+    {
+        if (settings_loaded)
+        {
+            // Part of the persisted configuration
+            continue;
+        }
+        if (nodemap.GetNode(node) != nullptr)
+        {
+            ok = ok && setOption(node, true);
+        }
+        else
+        {
+            yCWarning(PYLON_CAMERA) << "Camera" << m_serial_number << "has no" << node << "node, leaving it out";
+        }
+    }
+    if (!settings_loaded || config.check("width") || config.check("height"))
+    {
+        // The configured sensor size, m_width and m_height are the one of the rotated output
+        ok = ok && setSensorResolution(m_sensorWidth, m_sensorHeight);
+    }
+    else
+    {
+        setSensorSize(static_cast<std::uint32_t>(CIntegerParameter(nodemap, "Width").GetValue()), static_cast<std::uint32_t>(CIntegerParameter(nodemap, "Height").GetValue()));
+    }
+
+#if defined USE_CUDA
+    // The GPU path implements the rotation by itself, the sensor flips are not used
+    m_cameraFlips = false;
+#else
+    m_cameraFlips = CBooleanParameter(nodemap, "ReverseX").IsValid() && CBooleanParameter(nodemap, "ReverseY").IsValid();
+#endif  // USE_CUDA
+    {
+        // The flips left by a persisted configuration or by a previous session, until they are written
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_sensorReverseX = m_cameraFlips && CBooleanParameter(nodemap, "ReverseX").GetValue();
+        m_sensorReverseY = m_cameraFlips && CBooleanParameter(nodemap, "ReverseY").GetValue();
+        updateHostTransform();
+    }
+    ok = ok && applyOrientation();
+
+    if (!pixelFormatToNode.at(pixel_format).empty())
+    {
+        ok = ok && setOption("PixelFormat", pixelFormatToNode.at(pixel_format).c_str(), true);
+        m_hostConversion = true;
+    }
+
+    // TODO disabling it for testing the network, probably it is better to keep it as Auto
+    if (!settings_loaded && m_features[YARP_FEATURE_EXPOSURE].autoMode.IsValid())
+    {
+        ok = ok && setAutoMode(YARP_FEATURE_EXPOSURE, "Off");
+    }
+
+    if (!settings_loaded || config.check("period"))
+    {
+        ok = ok && setFramerate(m_fps);
+    }
+    else
+    {
+        m_fps = m_features[YARP_FEATURE_FRAME_RATE].value.GetValue();
+    }
+    if (m_stereo)
+    {
+        // The pair is exposed on the same software trigger, the frame rate is given by the trigger
+        ok = ok && setOption("TriggerSelector", "FrameStart", true);
+        ok = ok && setOption("TriggerMode", "On", true);
+        ok = ok && setOption("TriggerSource", "Software", true);
+    }
+
+    chunks_enabled = false;
+    if (chunk_metadata)
+    {
+        chunks_enabled = enableChunks();
+    }
+
+    // Additional nodes from the configuration, e.g. [camera_features] ExposureTime 5000.0
+    auto& features = config.findGroup("camera_features");
+    for (size_t i = 1; i < features.size(); ++i)
+    {
+        auto* feature = features.get(i).asList();
+        if (feature == nullptr || feature->size() != 2)
+        {
+            yCError(PYLON_CAMERA) << "camera_features entries must be <node> <value> pairs, got" << features.get(i).toString();
+            ok = false;
+            continue;
+        }
+        ok = setOptionFromValue(feature->get(0).asString(), feature->get(1)) && ok;
+    }
+    if (ok)
+    {
+        ok = commitTransaction();
+    }
+    else
+    {
+        abortTransaction();
+    }
+
+    yCDebug(PYLON_CAMERA) << "Starting with this fps" << CFloatParameter(nodemap, "AcquisitionFrameRate").GetValue();
+    // Until the chunks of the frames tell it
+    CFloatParameter exposure_time(nodemap, "ExposureTime");
+    if (exposure_time.IsReadable())
+    {
+        m_exposureTime = exposure_time.GetValue();
+    }
+    return ok;
+}
+
+std::vector<Pylon::CInstantCamera*> pylonCameraDriver::cameras() const
+{
+    std::vector<Pylon::CInstantCamera*> opened;
+    for (const auto* camera : {&m_camera_ptr, &m_rightCamera_ptr})
+    {
+        if (*camera)
+        {
+            opened.push_back(camera->get());
+        }
+    }
+    return opened;
+}
+
+bool pylonCameraDriver::isFeatureFile(const std::string& target)
+{
+    static const std::string extension{".pfs"};
+    return target.size() > extension.size() && target.compare(target.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+bool pylonCameraDriver::loadCameraSettings(bool& loaded)
+{
+    loaded = false;
+    if (!m_featureFile.empty() && !std::ifstream(m_featureFile).good())
+    {
+        yCWarning(PYLON_CAMERA) << "Feature file" << m_featureFile << "not found, applying the configuration. The rpc command save creates it";
+        return true;
+    }
+    if (m_featureFile.empty() && m_userSet.empty())
+    {
+        return true;
+    }
+    // Both cameras of a stereo pair get the same configuration
+    double start = yarp::os::Time::now();
+    for (auto* camera : cameras())
+    {
+        auto serial_number = camera->GetDeviceInfo().GetSerialNumber();
+        try
+        {
+            if (!m_featureFile.empty())
+            {
+                CFeaturePersistence::Load(m_featureFile.c_str(), &camera->GetNodeMap(), true);
+            }
+            else
+            {
+                CEnumParameter(camera->GetNodeMap(), "UserSetSelector").SetValue(m_userSet.c_str());
+                CCommandParameter(camera->GetNodeMap(), "UserSetLoad").Execute();
+            }
+        }
+        catch (const GenericException& e)
+        {
+            yCError(PYLON_CAMERA) << "Camera" << serial_number << "cannot load" << (m_featureFile.empty() ? m_userSet : m_featureFile) << "error:" << e.GetDescription();
+            return false;
+        }
+    }
+    invalidateShadowRegisters();
+    yCInfo(PYLON_CAMERA) << "Loaded" << (m_featureFile.empty() ? "the user set" : "the feature file") << (m_featureFile.empty() ? m_userSet : m_featureFile) << "in"
+                         << yarp::os::Time::now() - start << "s";
+    loaded = true;
+    return true;
+}
+
+bool pylonCameraDriver::saveCameraSettings(const std::string& target)
+{
+    if (!m_camera_ptr)
+    {
+        yCError(PYLON_CAMERA) << "There is no camera to save the settings of";
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (m_transactions.find(std::this_thread::get_id()) != m_transactions.end())
+    {
+        yCError(PYLON_CAMERA) << "Cannot save the settings inside a transaction, commit or abort it first";
+        return false;
+    }
+    bool ok{true};
+    bool restart{false};
+    try
+    {
+        if (isFeatureFile(target))
+        {
+            // The right camera of a pair has the same configuration, the left one is saved
+            CFeaturePersistence::Save(target.c_str(), &m_camera_ptr->GetNodeMap());
+        }
+        else
+        {
+            for (auto* camera : cameras())
+            {
+                CEnumParameter(camera->GetNodeMap(), "UserSetSelector").SetValue(target.c_str());
+                CCommandParameter user_set_save(camera->GetNodeMap(), "UserSetSave");
+                if (!restart && isLockedWhileGrabbing(user_set_save.GetNode()))
+                {
+                    yCDebug(PYLON_CAMERA) << "UserSetSave cannot be executed while grabbing, restarting the stream";
+                    stopCamera();
+                    restart = true;
+                }
+                user_set_save.Execute();
+            }
+        }
+        yCInfo(PYLON_CAMERA) << "Camera" << m_serial_number << "settings saved to" << target;
+    }
+    catch (const GenericException& e)
+    {
+        yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot save the settings to" << target << "error:" << e.GetDescription();
+        ok = false;
+    }
+    return (!restart || startCamera()) && ok;
+}
+
+bool pylonCameraDriver::openRightCamera()
+{
+    try
+    {
+        m_rightCamera_ptr = std::make_unique<Pylon::CInstantCamera>(m_runtime->createDevice(m_rightSerialNumber));
+        m_rightCamera_ptr->Open();
+    }
+    catch (const GenericException& e)
+    {
+        yCError(PYLON_CAMERA) << "Right camera" << m_rightSerialNumber << "cannot be opened, error:" << e.GetDescription();
+        return false;
+    }
+    yCInfo(PYLON_CAMERA) << "Stereo pair: left" << m_serial_number << "right" << m_rightSerialNumber << "-" << m_rightCamera_ptr->GetDeviceInfo().GetModelName();
+    return true;
+}
+
+bool pylonCameraDriver::openReplay(const std::string& path, bool loop)
+{
+    auto replay = std::make_unique<pylonReplaySource>();
+    if (!replay->open(path, loop))
+    {
+        return false;
+    }
+    // No camera behind: the resolution and the pixel format are the recorded ones, the orientation is done on the host but
+    // for the flips already applied by the recorded camera (frameArrived())
+    const auto& first = replay->firstRecord();
+    setSensorSize(first.width, first.height);
+    m_cameraFlips = false;
+    m_hostConversion = true;
+    applyOrientation();
+    yCInfo(PYLON_CAMERA) << "Replaying" << replay->frameCount() << "frames of" << path << (loop ? "in loop" : "once");
+    m_frameSource = std::move(replay);
+    return true;
+}
+
+bool pylonCameraDriver::close()
+{
+    m_rpcPort.close();
+    stopWatchdog();
+    stopGrabThread();
+    m_recorder.close();
+    m_metadataPort.close();
+    m_frameSource.reset();
+    m_rightFrameSource.reset();
+    // The cameras destroy their devices, then the pylon resources are released if no other device uses them
+    m_camera_ptr.reset();
+    m_rightCamera_ptr.reset();
+    m_removalHandlers.clear();
+    m_runtime.reset();
+    return true;
+}
+
+bool pylonCameraDriver::applyOrientation()
+{
+    if (!m_cameraFlips)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        updateHostTransform();
+        return true;
+    }
+    pylonImageKernels::orientation wanted;
+    pylonImageKernels::rotationOrientation(m_rotation, m_mirror, wanted);
+
+    // The sensor can do the flip, the host only the transpose. The host transform is changed when the flips are applied,
+    // together with them (writeApplied), and the frames in flight captured with the old flips are dropped by a restart
+    bool reverse_x{false};
+    bool reverse_y{false};
+    pylonImageKernels::sensorFlips(wanted, reverse_x, reverse_y);
+    beginTransaction();
+    bool ok = setOption("ReverseX", reverse_x) && setOption("ReverseY", reverse_y);
+    if (!ok)
+    {
+        abortTransaction();
+    }
+    ok = ok && commitTransaction();
+    if (!ok)
+    {
+        yCWarning(PYLON_CAMERA) << "Cannot flip on camera" << m_serial_number << "the host does what the sensor does not";
+    }
+    return ok;
+}
+
+void pylonCameraDriver::updateHostTransform()
+{
+    pylonImageKernels::orientation wanted;
+    pylonImageKernels::rotationOrientation(m_rotation, m_mirror, wanted);
+    auto host = pylonImageKernels::hostOrientation(wanted, m_sensorReverseX, m_sensorReverseY);
+    m_sensorFlips = (m_sensorReverseX ? pylonRecording::reverseX : 0U) | (m_sensorReverseY ? pylonRecording::reverseY : 0U);
+    m_hostTransform = pylonImageKernels::transformRgbKernel(host.transpose, host.reverseRows, host.reverseCols);
+    m_hostMonoTransform = pylonImageKernels::transformMonoKernel(host.transpose, host.reverseRows, host.reverseCols);
+    yCInfo(PYLON_CAMERA) << "Rotation" << m_rotation << "mirror" << m_mirror << "- on camera: ReverseX" << m_sensorReverseX << "ReverseY" << m_sensorReverseY
+                         << "- on host:" << (host.transpose ? "transpose" : "no transpose") << "reverse rows" << host.reverseRows << "reverse columns" << host.reverseCols;
+}
+
+int pylonCameraDriver::getRgbHeight()
+{
+    return m_height;
+}
+
+int pylonCameraDriver::getRgbWidth()
+{
+    return outputWidth();
+}
+
+bool pylonCameraDriver::getRgbSupportedConfigurations(yarp::sig::VectorOf<CameraConfig>& configurations)
+{
+    YARP_UNUSED(configurations);
+    yCWarning(PYLON_CAMERA) << "getRgbSupportedConfigurations not implemented yet";
+    return false;
+}
+
+bool pylonCameraDriver::getRgbResolution(int& width, int& height)
+{
+    width = outputWidth();
+    height = m_height;
+    return true;
+}
+
+bool pylonCameraDriver::setRgbResolution(int width, int height)
+{
+    if (m_stereo)
+    {
+        // The images are the two frames side by side
+        if (width % 2 != 0)
+        {
+            yCError(PYLON_CAMERA) << "The width of a stereo pair must be even, got" << width;
+            return false;
+        }
+        width /= 2;
+    }
+    if (m_rotation == -90.0 || m_rotation == 90.0)
+    {
+        // The images are rotated, the sensor has the transposed size
+        std::swap(width, height);
+    }
+    return setSensorResolution(width, height);
+}
+
+uint32_t pylonCameraDriver::outputWidth() const
+{
+    uint32_t width = m_width;
+    return m_stereo ? 2 * width : width;
+}
+
+bool pylonCameraDriver::setSensorResolution(int width, int height)
+{
+    bool res = false;
+    if (width > 0 && height > 0)
+    {
+        // The sizes are updated when the writes are applied (writeApplied), inside a transaction only by its commit
+        res = setOption("Width", width);
+        res = res && setOption("Height", height);
+    }
+    return res;
+}
+
+void pylonCameraDriver::setSensorSize(std::uint32_t width, std::uint32_t height)
+{
+    m_sensorWidth = width;
+    m_sensorHeight = height;
+    if (m_rotation == -90.0 || m_rotation == 90.0)
+    {
+        std::swap(width, height);
+    }
+    m_width = width;
+    m_height = height;
+}
+
+bool pylonCameraDriver::setRgbFOV(double horizontalFov, double verticalFov)
+{
+    YARP_UNUSED(horizontalFov);
+    YARP_UNUSED(verticalFov);
+    yCWarning(PYLON_CAMERA) << "setRgbFOV not supported";
+    return false;
+}
+
+bool pylonCameraDriver::getRgbFOV(double& horizontalFov, double& verticalFov)
+{
+    YARP_UNUSED(horizontalFov);
+    YARP_UNUSED(verticalFov);
+    yCWarning(PYLON_CAMERA) << "getRgbFOV not supported";
+    return false;
+}
+
+bool pylonCameraDriver::getRgbMirroring(bool& mirror)
+{
+    mirror = m_mirror;
+    return true;
+}
+
+bool pylonCameraDriver::setRgbMirroring(bool mirror)
+{
+    m_mirror = mirror;
+    return applyOrientation();
+}
+
+bool pylonCameraDriver::getRgbIntrinsicParam(Property& intrinsic)
+{
+    YARP_UNUSED(intrinsic);
+    yCWarning(PYLON_CAMERA) << "getRgbIntrinsicParam not implemented yet";
+    return false;
+}
+
+bool pylonCameraDriver::getCameraDescription(CameraDescriptor* camera)
+{
+    YARP_UNUSED(camera);
+    yCWarning(PYLON_CAMERA) << "getCameraDescription not implemented yet";
+    return false;
+}
+
+bool pylonCameraDriver::hasFeature(int feature, bool* hasFeature)
+{
+    cameraFeature_id_t f;
+    f = static_cast<cameraFeature_id_t>(feature);
+    if (f < YARP_FEATURE_BRIGHTNESS || f > YARP_FEATURE_NUMBER_OF - 1)
+    {
+        return false;
+    }
+
+    // The nodes missing on the camera have been detected at open (or at the reconnection)
+    *hasFeature = (m_validValues >> f) & 1U;
+
+    return true;
+}
+
+bool pylonCameraDriver::setFeature(int feature, double value)
+{
+    bool b = false;
+    if (!hasFeature(feature, &b) || !b)
+    {
+        yCError(PYLON_CAMERA) << "Feature not supported!";
+        return false;
+    }
+    b = false;
+    auto f = static_cast<cameraFeature_id_t>(feature);
+    switch (f)
+    {
+        case YARP_FEATURE_BRIGHTNESS:
+            b = setFeatureValue(f, fromZeroOneToRange(f, value));
+            break;
+        case YARP_FEATURE_EXPOSURE:
+            // According to https://www.kernel.org/doc/html/v4.8/media/uapi/v4l/extended-controls.html
+            // 1 unit = 100us, basler instead accept us. Setting directly in us.
+            b = setFeatureValue(f, fromZeroOneToRange(f, value));
+            break;
+        case YARP_FEATURE_SHARPNESS:
+            b = setFeatureValue(f, fromZeroOneToRange(f, value));
+            break;
+        case YARP_FEATURE_WHITE_BALANCE:
+            b = false;
+            yCError(PYLON_CAMERA) << "White balance require 2 values";
+            break;
+        case YARP_FEATURE_GAIN:
+            b = setFeatureValue(f, fromZeroOneToRange(f, value));
+            break;
+        case YARP_FEATURE_FRAME_RATE:
+            b = setFramerate(value);
+            break;
+        default:
+            yCError(PYLON_CAMERA) << "Feature not supported!";
+            return false;
+    }
+
+    return b;
+}
+
+bool pylonCameraDriver::getFeature(int feature, double* value)
+{
+    bool b = false;
+    if (!hasFeature(feature, &b) || !b)
+    {
+        yCError(PYLON_CAMERA) << "Feature not supported!";
+        return false;
+    }
+    b = false;
+    auto f = static_cast<cameraFeature_id_t>(feature);
+    switch (f)
+    {
+        case YARP_FEATURE_BRIGHTNESS:
+            b = getFeatureValue(f, value);
+            break;
+        case YARP_FEATURE_EXPOSURE:
+            b = getFeatureValue(f, value);
+            break;
+        case YARP_FEATURE_SHARPNESS:
+            b = getFeatureValue(f, value);
+            break;
+        case YARP_FEATURE_WHITE_BALANCE:
+            b = false;
+            yCError(PYLON_CAMERA) << "White balance is a 2-values feature";
+            break;
+        case YARP_FEATURE_GAIN:
+            b = getFeatureValue(f, value);
+            break;
+        case YARP_FEATURE_FRAME_RATE:
+            b = true;
+            *value = m_fps;
+            break;
+        default:
+            yCError(PYLON_CAMERA) << "Feature not supported!";
+            return false;
+    }
+
+    *value = fromRangeToZeroOne(f, *value);
+    yCDebug(PYLON_CAMERA) << "In 0-1" << *value;
+    return b;
+}
+
+bool pylonCameraDriver::setFeature(int feature, double value1, double value2)
+{
+    auto f = static_cast<cameraFeature_id_t>(feature);
+    if (f != YARP_FEATURE_WHITE_BALANCE)
+    {
+        yCError(PYLON_CAMERA) << YARP_FEATURE_WHITE_BALANCE << "is not a 2-values feature supported";
+        return false;
+    }
+
+    // The four writes are applied together, the selector order is kept
+    beginTransaction();
+    auto res = selectBalanceRatio("Blue");
+    res = res && setFeatureValue(f, fromZeroOneToRange(f, value1));
+    res = res && selectBalanceRatio("Red");
+    res = res && setFeatureValue(f, fromZeroOneToRange(f, value2));
+    if (!res)
+    {
+        abortTransaction();
+        return false;
+    }
+    return commitTransaction();
+}
+
+bool pylonCameraDriver::getFeature(int feature, double* value1, double* value2)
+{
+    auto f = static_cast<cameraFeature_id_t>(feature);
+    if (f != YARP_FEATURE_WHITE_BALANCE)
+    {
+        yCError(PYLON_CAMERA) << "This is not a 2-values feature supported";
+        return false;
+    }
+
+    auto res = getBalanceRatio("Blue", value1);
+    res = res && getBalanceRatio("Red", value2);
+    *value1 = fromRangeToZeroOne(f, *value1);
+    *value2 = fromRangeToZeroOne(f, *value2);
+    yCDebug(PYLON_CAMERA) << "In 0-1" << *value1;
+    yCDebug(PYLON_CAMERA) << "In 0-1" << *value2;
+    return res;
+}
+
+bool pylonCameraDriver::getBalanceRatio(const char* selector, double* value)
+{
+    // The selector is written only if the ratio is not cached, and being writable while grabbing it never restarts the stream
+    yarp::os::Value cached;
+    if (readShadow("BalanceRatio", cached, selector))
+    {
+        *value = cached.asFloat64();
+        return true;
+    }
+    yarp::os::Value selected;
+    if ((!readShadow("BalanceRatioSelector", selected) || selected.asString() != selector) && !selectBalanceRatio(selector))
+    {
+        return false;
+    }
+    return getFeatureValue(YARP_FEATURE_WHITE_BALANCE, value);
+}
+
+bool pylonCameraDriver::hasOnOff(int feature, bool* HasOnOff)
+{
+    return hasAuto(feature, HasOnOff);
+}
+
+bool pylonCameraDriver::setActive(int feature, bool onoff)
+{
+    bool b = false;
+    if (!hasFeature(feature, &b) || !b)
+    {
+        yCError(PYLON_CAMERA) << "Feature" << feature << "not supported!";
+        return false;
+    }
+
+    if (!hasOnOff(feature, &b) || !b)
+    {
+        yCError(PYLON_CAMERA) << "Feature" << feature << "does not have OnOff.. call hasOnOff() to know if a specific feature support OnOff mode";
+        return false;
+    }
+
+    std::string val_to_set = onoff ? "Continuous" : "Off";
+    b = setAutoMode(static_cast<cameraFeature_id_t>(feature), val_to_set.c_str());
+
+    return b;
+}
+
+bool pylonCameraDriver::getActive(int feature, bool* isActive)
+{
+    bool b = false;
+    if (!hasFeature(feature, &b) || !b)
+    {
+        yCError(PYLON_CAMERA) << "Feature" << feature << "not supported!";
+        return false;
+    }
+
+    if (!hasOnOff(feature, &b) || !b)
+    {
+        yCError(PYLON_CAMERA) << "Feature" << feature << "does not have OnOff.. call hasOnOff() to know if a specific feature support OnOff mode";
+        return false;
+    }
+
+    std::string val_to_get{""};
+    b = getAutoMode(static_cast<cameraFeature_id_t>(feature), val_to_get);
+    if (b)
+    {
+        if (val_to_get == "Continuous")
+        {
+            *isActive = true;
+        }
+        else if (val_to_get == "Off")
+        {
+            *isActive = false;
+        }
+    }
+    return b;
+}
+
+bool pylonCameraDriver::hasAuto(int feature, bool* hasAuto)
+{
+    cameraFeature_id_t f;
+    f = static_cast<cameraFeature_id_t>(feature);
+    if (f < YARP_FEATURE_BRIGHTNESS || f > YARP_FEATURE_NUMBER_OF - 1)
+    {
+        return false;
+    }
+
+    *hasAuto = hasAutoMode(f);
+
+    return true;
+}
+
+bool pylonCameraDriver::hasManual(int feature, bool* hasManual)
+{
+    return hasFeature(feature, hasManual);
+}
+
+bool pylonCameraDriver::hasOnePush(int feature, bool* hasOnePush)
+{
+    return hasAuto(feature, hasOnePush);
+}
+
+bool pylonCameraDriver::setMode(int feature, FeatureMode mode)
+{
+    bool b{false};
+    if (!hasAuto(feature, &b) || !b)
+    {
+        yCError(PYLON_CAMERA) << "Feature" << feature << "not supported!";
+        return false;
+    }
+
+    switch (mode)
+    {
+        case MODE_AUTO:
+            return setActive(feature, true);
+        case MODE_MANUAL:
+            return setActive(feature, false);
+        case MODE_UNKNOWN:
+            return false;
+        default:
+            return false;
+    }
+    return b;
+}
+
+bool pylonCameraDriver::getMode(int feature, FeatureMode* mode)
+{
+    bool b{false};
+    if (!hasAuto(feature, &b) || !b)
+    {
+        yCError(PYLON_CAMERA) << "Feature" << feature << "not supported!";
+        return false;
+    }
+    bool get_active{false};
+    b = b && getActive(feature, &get_active);
+
+    if (b)
+    {
+        if (get_active)
+        {
+            *mode = MODE_AUTO;
+        }
+        else
+        {
+            *mode = MODE_MANUAL;
+        }
+    }
+    return b;
+}
+
+bool pylonCameraDriver::setOnePush(int feature)
+{
+    bool b = false;
+    if (!hasOnePush(feature, &b) || !b)
+    {
+        yCError(PYLON_CAMERA) << "Feature" << feature << "doesn't have OnePush";
+        return false;
+    }
+
+    b = b && setMode(feature, MODE_AUTO);
+    b = b && setMode(feature, MODE_MANUAL);
+
+    return b;
+}
+
+bool pylonCameraDriver::retrieveFrame(pylonFrame& frame)
+{
+    if (m_frameSource && m_frameSource->isGrabbing())
+    {
+        // Wait for an image and then retrieve it, a stall is reported within a few frame intervals
+        unsigned int timeout_ms = retrieveTimeout();
+        bool succeeded{false};
+        try
+        {
+            auto retrieve_start = pylonLatencyHistogram::now();
+            if (m_stereo && !triggerPair(timeout_ms))
+            {
+                m_frameCounters.add(pylonFrameCounters::failed);
+                return false;
+            }
+            succeeded = m_frameSource->retrieveFrame(timeout_ms, frame);
+            m_lastRetrieveTime = yarp::os::Time::now();
+            countFrame(frame);
+            if (succeeded && m_stereo)
+            {
+                succeeded = m_rightFrameSource->retrieveFrame(timeout_ms, m_rightFrame);
+                m_rightRetrieveTime = yarp::os::Time::now();
+                countFrame(m_rightFrame);
+            }
+            m_lastRetrieveNs = pylonLatencyHistogram::now();
+            m_stageLatency[stageRetrieve].record(m_lastRetrieveNs - retrieve_start);
+        }
+        catch (const Pylon::GenericException& e)
+        {
+            // Error handling.
+            yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot get images error:" << e.GetDescription();
+            m_frameCounters.add(pylonFrameCounters::failed);
+            m_pairBroken = m_stereo;
+            return false;
+        }
+        // Image grabbed successfully?
+        if (succeeded)
+        {
+            return frameArrived(frame);
+        }
+        else if (m_frameSource->isGrabbing())
+        {
+            // Already counted and reported by the source with its error
+            m_pairBroken = m_stereo;
+            return false;
+        }
+        else
+        {
+            // Stopped while waiting, or the end of a replay
+            return false;
+        }
+    }
+    else
+    {
+        yCError(PYLON_CAMERA) << "Errors in retrieving images";
+        return false;
+    }
+}
+
+unsigned int pylonCameraDriver::retrieveTimeout() const
+{
+    double interval = std::max(m_fps > 0.0F ? 1.0 / m_fps : 0.0, 1e-6 * m_exposureTime);
+    double timeout = retrieveTimeoutIntervals * interval + retrieveTimeoutMargin;
+    if (m_firstAcquisition)
+    {
+        timeout = std::max(timeout, firstFrameTimeout);
+    }
+    return static_cast<unsigned int>(std::ceil(1000.0 * timeout));
+}
+
+void pylonCameraDriver::countFrame(const pylonFrame& frame)
+{
+    m_frameCounters.add(pylonFrameCounters::skipped, frame.skippedFrames);
+    if (frame.lostFrames > 0)
+    {
+        m_frameCounters.add(pylonFrameCounters::lost, frame.lostFrames);
+        yCWarningThrottle(PYLON_CAMERA, 1.0) << frame.lostFrames << "frames sent by the camera have not been received, check the bandwidth of the link";
+    }
+    if (frame.status != pylonGrabStatus::succeeded)
+    {
+        m_frameCounters.add(frame.status == pylonGrabStatus::incomplete ? pylonFrameCounters::incomplete : pylonFrameCounters::failed);
+        std::lock_guard<std::mutex> guard(m_failureCodesMutex);
+        ++m_failureCodes[frame.errorCode];
+    }
+}
+
+bool pylonCameraDriver::frameArrived(const pylonFrame& frame)
+{
+    if (frame.metadata.hasExposureTime)
+    {
+        m_exposureTime = frame.metadata.exposureTime;
+    }
+    // A change of the sensor flips restarts the stream: the frame has been captured with the flips of the current host transform.
+    // A replayed frame has those it was recorded with, the host does only what they leave of the orientation
+    std::uint32_t sensor_flips = m_sensorFlips;
+    if (m_camera_ptr)
+    {
+        m_frameHostTransform = m_hostTransform.load();
+        m_frameHostMonoTransform = m_hostMonoTransform.load();
+    }
+    else
+    {
+        sensor_flips = frame.sensorFlips;
+        pylonImageKernels::orientation wanted;
+        pylonImageKernels::rotationOrientation(m_rotation, m_mirror, wanted);
+        auto host = pylonImageKernels::hostOrientation(wanted, (sensor_flips & pylonRecording::reverseX) != 0, (sensor_flips & pylonRecording::reverseY) != 0);
+        m_frameHostTransform = pylonImageKernels::transformRgbKernel(host.transpose, host.reverseRows, host.reverseCols);
+        m_frameHostMonoTransform = pylonImageKernels::transformMonoKernel(host.transpose, host.reverseRows, host.reverseCols);
+    }
+    size_t width{0};
+    size_t height{0};
+    frameOutputSize(frame, width, height);
+    m_width = static_cast<uint32_t>(width);
+    m_height = static_cast<uint32_t>(height);
+    updateClockSync(m_clock, frame, m_lastRetrieveTime);
+    if (m_stereo)
+    {
+        if (m_rightFrame.width != frame.width || m_rightFrame.height != frame.height || m_rightFrame.pixelType != frame.pixelType)
+        {
+            yCErrorThrottle(PYLON_CAMERA, 1.0) << "The cameras of the pair deliver different frames, check their configuration";
+            m_frameCounters.add(pylonFrameCounters::failed);
+            return false;
+        }
+        updateClockSync(m_rightClock, m_rightFrame, m_rightRetrieveTime);
+        if (m_clock.sync.isValid() && m_rightClock.sync.isValid())
+        {
+            m_pairSkew = m_rightClock.sync.toHostTime(m_rightFrame.timestamp) - m_clock.sync.toHostTime(frame.timestamp);
+            m_pairSkewHistogram.record(static_cast<std::uint64_t>(std::abs(m_pairSkew) * 1e9));
+        }
+    }
+
+    // For some reason the first frame cannot be converted To be investigated
+    if (m_firstAcquisition)
+    {
+        yCDebug(PYLON_CAMERA) << "Skipping";
+        m_firstAcquisition = false;
+        return false;
+    }
+    if (m_recorder.isOpen())
+    {
+        m_recorder.push(frame, m_grabbedFrames + 1, m_lastRetrieveTime, sensor_flips);
+    }
+    return true;
+}
+
+void pylonCameraDriver::frameGrabbed(bool succeeded, const pylonFrame& frame)
+{
+    // Nothing waits for the frame in this mode, the retrieve stage stays empty
+    m_lastRetrieveTime = yarp::os::Time::now();
+    m_lastRetrieveNs = pylonLatencyHistogram::now();
+    if (!m_grabThreadRunning)
+    {
+        return;
+    }
+    pylonAllocationScope allocations(m_allocations);
+    countFrame(frame);
+    if (!succeeded)
+    {
+        return;
+    }
+    if (frameArrived(frame))
+    {
+        publishFrame(frame);
+    }
+}
+
+void pylonCameraDriver::setupClockSync(Pylon::CInstantCamera* camera, const pylonFrameSource& source, cameraClock& clock)
+{
+    clock.sync = pylonClockSync(source.tickPeriod());
+    if (camera == nullptr)
+    {
+        // A recording has no clock to latch, its frames are mapped with their retrieve times
+        return;
+    }
+    auto& node_map = camera->GetNodeMap();
+    for (const auto& latch : timestampLatchNodes)
+    {
+        if (clock.latch.Attach(node_map, latch.first.c_str()) && clock.latch.IsValid() && clock.latchValue.Attach(node_map, latch.second.c_str()) && clock.latchValue.IsValid())
+        {
+            yCInfo(PYLON_CAMERA) << "Synchronizing the clock of camera" << camera->GetDeviceInfo().GetSerialNumber() << "with" << latch.first;
+            return;
+        }
+        clock.latch.Release();
+        clock.latchValue.Release();
+    }
+    yCInfo(PYLON_CAMERA) << "Camera" << camera->GetDeviceInfo().GetSerialNumber() << "cannot latch its timestamp, synchronizing the clock with the frame arrival times";
+}
+
+void pylonCameraDriver::updateClockSync(cameraClock& clock, const pylonFrame& frame, double retrieve_time)
+{
+    if (!clock.latch.IsValid())
+    {
+        // The frames arrive with a variable latency, the lower envelope of the samples removes it
+        clock.sync.addSample(frame.timestamp, retrieve_time);
+        return;
+    }
+    if (retrieve_time - clock.lastLatchTime < timestampLatchPeriod)
+    {
+        return;
+    }
+    try
+    {
+        // The latched value lies between the two host times
+        double before = yarp::os::Time::now();
+        clock.latch.Execute();
+        double after = yarp::os::Time::now();
+        clock.sync.addSample(static_cast<std::uint64_t>(clock.latchValue.GetValue()), 0.5 * (before + after));
+        clock.lastLatchTime = after;
+    }
+    catch (const GenericException& e)
+    {
+        yCErrorThrottle(PYLON_CAMERA, 1.0) << "Camera" << m_serial_number << "cannot latch its timestamp error:" << e.GetDescription();
+    }
+}
+
+bool pylonCameraDriver::triggerPair(unsigned int timeout_ms)
+{
+    // Only retrieveFrame() calls it, with m_streamMutex held in both the thread and the sync modes (the event one does
+    // not support stereo pairs): the restart is serialized with stopCamera() and startCamera()
+    if (m_pairBroken)
+    {
+        // A half lost leaves the other one queued, the next pair would be mismatched
+        yCWarning(PYLON_CAMERA) << "Restarting the stereo pair to realign it";
+        stopSources();
+        if (!startSources())
+        {
+            yCErrorThrottle(PYLON_CAMERA, 1.0) << "Cannot restart the stereo pair, retrying at the next frame";
+            return false;
+        }
+        m_pairBroken = false;
+    }
+    // Both cameras must be ready before any of them is fired, the skew is then the one of two back to back commands
+    m_camera_ptr->WaitForFrameTriggerReady(timeout_ms, TimeoutHandling_ThrowException);
+    m_rightCamera_ptr->WaitForFrameTriggerReady(timeout_ms, TimeoutHandling_ThrowException);
+    m_camera_ptr->ExecuteSoftwareTrigger();
+    m_rightCamera_ptr->ExecuteSoftwareTrigger();
+    return true;
+}
+
+void pylonCameraDriver::frameOutputSize(const pylonFrame& frame, size_t& width, size_t& height) const
+{
+    width = frame.width;
+    height = frame.height;
+    if (m_rotation == -90.0 || m_rotation == 90.0)
+    {
+        std::swap(width, height);
+    }
+}
+
+yarp::os::Stamp pylonCameraDriver::frameStamp(const pylonFrame& frame, std::uint64_t sequence)
+{
+    if (!m_clock.sync.isValid())
+    {
+        return yarp::os::Stamp(static_cast<int>(sequence), m_lastRetrieveTime);
+    }
+    // The camera stamps the start of the exposure
+    double time = m_clock.sync.toHostTime(frame.timestamp);
+    if (frame.metadata.hasExposureTime)
+    {
+        time += 0.5e-6 * frame.metadata.exposureTime;
+    }
+    return yarp::os::Stamp(static_cast<int>(sequence), time);
+}
+
+bool pylonCameraDriver::enableChunks()
+{
+    auto& node_map = m_camera_ptr->GetNodeMap();
+    CEnumParameter selector(node_map, "ChunkSelector");
+    if (!CBooleanParameter(node_map, "ChunkModeActive").IsValid() || !selector.IsValid())
+    {
+        yCWarning(PYLON_CAMERA) << "Camera" << m_serial_number << "does not support chunks, the per-frame metadata is not available";
+        return false;
+    }
+    bool ok = setOption("ChunkModeActive", true);
+    for (const auto& chunk : chunkNodes)
+    {
+        // Every camera model has its own set of chunks, the missing ones are just skipped
+        if (!selector.CanSetValue(chunk.first.c_str()))
+        {
+            yCWarning(PYLON_CAMERA) << "Camera" << m_serial_number << "has no" << chunk.second << "chunk";
+            continue;
+        }
+        ok = ok && setOption("ChunkSelector", chunk.first.c_str(), true);
+        ok = ok && setOption("ChunkEnable", true);
+    }
+    return ok;
+}
+
+void pylonCameraDriver::setLastFrameMetadata(const frameMetadata& metadata, const yarp::os::Stamp& stamp, std::uint64_t sequence, double skew)
+{
+    std::lock_guard<std::mutex> guard(m_metadataMutex);
+    m_lastMetadata = metadata;
+    m_lastPairSkew = skew;
+    m_rgb_stamp = stamp;
+    // The rgb and the mono outputs of the same frame are published once
+    if (sequence == m_lastMetadataSequence || m_metadataPort.isClosed())
+    {
+        return;
+    }
+    m_lastMetadataSequence = sequence;
+    auto& bottle = m_metadataPort.prepare();
+    bottle.clear();
+    if (metadata.hasFrameId)
+    {
+        auto& entry = bottle.addList();
+        entry.addString("frame_id");
+        entry.addInt64(metadata.frameId);
+    }
+    if (metadata.hasTimestamp)
+    {
+        auto& entry = bottle.addList();
+        entry.addString("timestamp");
+        entry.addInt64(static_cast<std::int64_t>(metadata.timestamp));
+    }
+    if (metadata.hasExposureTime)
+    {
+        auto& entry = bottle.addList();
+        entry.addString("exposure_time");
+        entry.addFloat64(metadata.exposureTime);
+    }
+    if (metadata.hasGain)
+    {
+        auto& entry = bottle.addList();
+        entry.addString("gain");
+        entry.addFloat64(metadata.gain);
+    }
+    if (m_stereo)
+    {
+        auto& entry = bottle.addList();
+        entry.addString("skew");
+        entry.addFloat64(skew);
+    }
+    m_metadataPort.setEnvelope(stamp);
+    m_metadataPort.write();
+}
+
+bool pylonCameraDriver::processRgb(const pylonFrame& frame, yarp::sig::ImageOf<yarp::sig::PixelRgb>& image, size_t& bytes_copied)
+{
+    bytes_copied = 0;
+    // TODO Check pixel code
+    size_t width{0};
+    size_t height{0};
+    frameOutputSize(frame, width, height);
+    resizeImage(image, m_stereo ? 2 * width : width, height);
+    bool ok = processRgbAt(frame, image, 0, bytes_copied);
+    if (m_stereo)
+    {
+        ok = ok && processRgbAt(m_rightFrame, image, width, bytes_copied);
+    }
+    return ok;
+}
+
+bool pylonCameraDriver::processRgbAt(const pylonFrame& frame, yarp::sig::ImageOf<yarp::sig::PixelRgb>& image, size_t column, size_t& bytes_copied)
+{
+    // Both halves of a stereo pair are written in place, with the row size of the whole image
+    auto* dst = image.getRawImage() + column * sizeof(yarp::sig::PixelRgb);
+    size_t dst_stride = image.getRowSize();
+    try
+    {
+        auto host_transform = m_frameHostTransform;
+        if (host_transform)
+        {
+            // The converter writes straight into the input of the rotation, that writes straight into the yarp image
+            size_t rotation_input_size = frame.width * frame.height * image.getPixelSize();
+            resizeBuffer(m_rotationBuffer, rotation_input_size);
+            convertFrame(frame, m_rotationBuffer.data(), m_rotationBuffer.size(), 0);
+
+#if defined USE_CUDA
+            if (m_rotation != 0.0 && !m_mirror)
+            {
+                pylonStageTimer timer(m_stageLatency[stageTransform]);
+                size_t width{0};
+                size_t height{0};
+                frameOutputSize(frame, width, height);
+                Mat rotation_input(frame.height, frame.width, CV_8UC3, m_rotationBuffer.data());
+                Mat rotated(height, width, CV_8UC3, dst, dst_stride);
+                m_gpuRotationInput.upload(rotation_input);  // RAM => GPU
+
+                // Rotate from 90
+                cv::Size size = rotation_input.size();
+                // TODO che if the resulting image is W x H or viceversa
+                cv::cuda::rotate(m_gpuRotationInput, m_gpuRotated, cv::Size(size.height, size.width), m_rotation, size.height - 1, 0, cv::INTER_LINEAR);
+
+                m_gpuRotated.download(rotated);  // GPU => RAM
+                bytes_copied += rotation_input_size + width * height * sizeof(yarp::sig::PixelRgb);
+            }
+            else
+#endif  // USE_CUDA
+            {
+                // Single pass from the converted frame to the yarp image
+                pylonStageTimer timer(m_stageLatency[stageTransform]);
+                host_transform(m_rotationBuffer.data(), frame.width * sizeof(yarp::sig::PixelRgb), dst, dst_stride, frame.width, frame.height);
+            }
+        }
+        else if (m_stereo && !convertsOnHost(frame))
+        {
+            // The pylon converter fills the padding of each row, that here is the other half of the pair: the frame is
+            // converted into the rotation buffer (unused without a host transform) and its rows copied
+            size_t row_size = frame.width * sizeof(yarp::sig::PixelRgb);
+            resizeBuffer(m_rotationBuffer, row_size * frame.height);
+            convertFrame(frame, m_rotationBuffer.data(), m_rotationBuffer.size(), 0);
+            pylonStageTimer timer(m_stageLatency[stageCopy]);
+            for (size_t y = 0; y < frame.height; ++y)
+            {
+                memcpy(dst + y * dst_stride, m_rotationBuffer.data() + y * row_size, row_size);
+            }
+            bytes_copied += row_size * frame.height;
+        }
+        else
+        {
+            // Zero-copy: the converter writes straight into the yarp image, skipping its row padding (and the other half).
+            // Its size goes from dst to the end of the image, the padding after the last row of the left half included
+            convertFrame(frame, dst, frame.height * dst_stride - column * sizeof(yarp::sig::PixelRgb), dst_stride - frame.width * sizeof(yarp::sig::PixelRgb));
+        }
+    }
+    catch (const Pylon::GenericException& e)
+    {
+        yCError(PYLON_CAMERA) << "Frame invalid! Conversion error:" << e.GetDescription();
+        return false;
+    }
+    return true;
+}
+
+bool pylonCameraDriver::processMono(const pylonFrame& frame, yarp::sig::ImageOf<yarp::sig::PixelMono>& image, size_t& bytes_copied)
+{
+    bytes_copied = 0;
+    size_t width{0};
+    size_t height{0};
+    frameOutputSize(frame, width, height);
+    resizeImage(image, m_stereo ? 2 * width : width, height);
+    bool ok = processMonoAt(frame, image, 0, bytes_copied);
+    if (m_stereo)
+    {
+        ok = ok && processMonoAt(m_rightFrame, image, width, bytes_copied);
+    }
+    return ok;
+}
+
+bool pylonCameraDriver::processMonoAt(const pylonFrame& frame, yarp::sig::ImageOf<yarp::sig::PixelMono>& image, size_t column, size_t& bytes_copied)
+{
+    auto* dst = image.getRawImage() + column;
+    size_t dst_stride = image.getRowSize();
+    size_t width = frame.width;
+    size_t height = frame.height;
+    auto pixel_type = frame.pixelType;
+    auto host_transform = m_frameHostMonoTransform;
+    try
+    {
+        const std::uint8_t* src{nullptr};
+        size_t src_stride{0};
+        if (pixel_type == PixelType_Mono8 || pixelTypeToBayerPattern.find(pixel_type) != pixelTypeToBayerPattern.end())
+        {
+            // Native 8 bit data: no conversion at all, the pixels are taken straight from the grab buffer
+            src = frame.buffer;
+            src_stride = width + frame.paddingX;
+        }
+        else if (host_transform || m_stereo)
+        {
+            // Converted into a buffer also for a stereo pair, the converter fills the row padding, that is the other half
+            pylonStageTimer timer(m_stageLatency[stageConvert]);
+            resizeBuffer(m_monoBuffer, width * height);
+            setConverterPadding(m_monoConverter, m_monoConverterPadding, 0);
+            m_monoConverter.Convert(m_monoBuffer.data(), m_monoBuffer.size(), frame.buffer, frame.size, frame.pixelType, frame.width, frame.height, frame.paddingX, ImageOrientation_TopDown);
+            src = m_monoBuffer.data();
+            src_stride = width;
+        }
+        else
+        {
+            pylonStageTimer timer(m_stageLatency[stageConvert]);
+            setConverterPadding(m_monoConverter, m_monoConverterPadding, dst_stride - width);
+            m_monoConverter.Convert(dst, height * dst_stride - column, frame.buffer, frame.size, frame.pixelType, frame.width, frame.height, frame.paddingX,
+                                    ImageOrientation_TopDown);
+            return true;
+        }
+
+        if (host_transform)
+        {
+            pylonStageTimer timer(m_stageLatency[stageTransform]);
+            host_transform(src, src_stride, dst, dst_stride, width, height);
+        }
+        else
+        {
+            pylonStageTimer timer(m_stageLatency[stageCopy]);
+            for (size_t y = 0; y < height; ++y)
+            {
+                memcpy(dst + y * dst_stride, src + y * src_stride, width);
+            }
+            bytes_copied += width * height;
+        }
+    }
+    catch (const Pylon::GenericException& e)
+    {
+        yCError(PYLON_CAMERA) << "Frame invalid! Conversion error:" << e.GetDescription();
+        return false;
+    }
+    return true;
+}
+
+void pylonCameraDriver::convertFrame(const pylonFrame& frame, std::uint8_t* dst, size_t dst_size, size_t dst_padding)
+{
+    pylonStageTimer timer(m_stageLatency[stageConvert]);
+    if (m_hostConversion)
+    {
+        const auto* src = frame.buffer;
+        size_t width = frame.width;
+        size_t height = frame.height;
+        size_t dst_stride = width * sizeof(yarp::sig::PixelRgb) + dst_padding;
+        auto pixel_type = frame.pixelType;
+        auto bayer_pattern = pixelTypeToBayerPattern.find(pixel_type);
+        if (bayer_pattern != pixelTypeToBayerPattern.end())
+        {
+            m_bayerToRgb(src, width + frame.paddingX, dst, dst_stride, width, height, bayer_pattern->second);
+            return;
+        }
+        if (pixel_type == PixelType_YUV422_YUYV_Packed)
+        {
+            m_yuv422ToRgb(src, 2 * width + frame.paddingX, dst, dst_stride, width, height);
+            return;
+        }
+    }
+    // Any other format is converted by pylon
+    setConverterPadding(m_formatConverter, m_converterPadding, dst_padding);
+    m_formatConverter.Convert(dst, dst_size, frame.buffer, frame.size, frame.pixelType, frame.width, frame.height, frame.paddingX, ImageOrientation_TopDown);
+}
+
+bool pylonCameraDriver::convertsOnHost(const pylonFrame& frame) const
+{
+    return m_hostConversion && (pixelTypeToBayerPattern.find(frame.pixelType) != pixelTypeToBayerPattern.end() || frame.pixelType == PixelType_YUV422_YUYV_Packed);
+}
+
+void pylonCameraDriver::reportAllocation(const char* buffer_name)
+{
+    // Counted by pylonAllocationScope with all the others
+    yCDebug(PYLON_CAMERA) << "Camera" << m_serial_number << "allocated" << buffer_name;
+}
+
+void pylonCameraDriver::resizeImage(yarp::sig::Image& image, size_t width, size_t height)
+{
+    if (image.width() != width || image.height() != height)
+    {
+        image.resize(width, height);
+        reportAllocation("an image");
+    }
+}
+
+void pylonCameraDriver::resizeBuffer(std::vector<std::uint8_t>& buffer, size_t size)
+{
+    if (buffer.capacity() < size)
+    {
+        reportAllocation("a conversion buffer");
+    }
+    buffer.resize(size);
+}
+
+void pylonCameraDriver::setConverterPadding(Pylon::CImageFormatConverter& converter, size_t& current_padding, size_t padding)
+{
+    if (padding != current_padding)
+    {
+        converter.OutputPaddingX = padding;
+        current_padding = padding;
+    }
+}
+
+void pylonCameraDriver::allocateBuffers()
+{
+    // Sensor sized buffers
+    if (m_hostTransform.load())
+    {
+        resizeBuffer(m_rotationBuffer, static_cast<size_t>(m_sensorWidth) * m_sensorHeight * sizeof(yarp::sig::PixelRgb));
+    }
+
+    // Output sized buffers
+    uint32_t width = m_width;
+    uint32_t height = m_height;
+    if (m_stereo)
+    {
+        width *= 2;
+    }
+    for (auto& frame : m_rgbFrames.buffers())
+    {
+        resizeImage(frame.image, width, height);
+    }
+    for (auto& frame : m_monoFrames.buffers())
+    {
+        resizeImage(frame.image, width, height);
+    }
+}
+
+void pylonCameraDriver::grabLoop()
+{
+    while (m_grabThreadRunning)
+    {
+        // The camera is stopped while some parameters are written, just wait for it
+        if (!m_frameSource->isGrabbing())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        if (m_stereo)
+        {
+            // The pair is triggered at the frame rate, waited for before the stream lock: a stop does not wait a period
+            std::this_thread::sleep_until(m_nextTrigger);
+            auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / m_fps));
+            m_nextTrigger = std::max(m_nextTrigger + period, std::chrono::steady_clock::now());
+        }
+        pylonAllocationScope allocations(m_allocations);
+        pylonFrame source_frame;
+        bool retrieved{false};
+        {
+            // Serialized with the stop and the restart of the stream, a stopped one is waited for as above
+            std::lock_guard<std::mutex> guard(m_streamMutex);
+            retrieved = m_frameSource->isGrabbing() && retrieveFrame(source_frame);
+        }
+        if (retrieved)
+        {
+            publishFrame(source_frame);
+        }
+    }
+}
+
+void pylonCameraDriver::publishFrame(const pylonFrame& source_frame)
+{
+    ++m_grabbedFrames;
+    auto stamp = frameStamp(source_frame, m_grabbedFrames);
+    // Only the outputs that somebody asked for are produced
+    bool rgb_published{false};
+    bool mono_published{false};
+    if (m_rgbRequested)
+    {
+        auto& frame = m_rgbFrames.writeBuffer();
+        if (processRgb(source_frame, frame.image, frame.bytesCopied))
+        {
+            frame.sequence = m_grabbedFrames;
+            frame.metadata = source_frame.metadata;
+            frame.stamp = stamp;
+            frame.skew = m_pairSkew;
+            frame.retrieveTime = m_lastRetrieveNs;
+            m_rgbFrames.publish();
+            rgb_published = true;
+        }
+    }
+    if (m_monoRequested)
+    {
+        auto& frame = m_monoFrames.writeBuffer();
+        if (processMono(source_frame, frame.image, frame.bytesCopied))
+        {
+            frame.sequence = m_grabbedFrames;
+            frame.metadata = source_frame.metadata;
+            frame.stamp = stamp;
+            frame.skew = m_pairSkew;
+            frame.retrieveTime = m_lastRetrieveNs;
+            m_monoFrames.publish();
+            mono_published = true;
+        }
+    }
     {
-        yCError(PYLON_CAMERA) << "This is not a 2-values feature supported";
-        return false;
+        std::lock_guard<std::mutex> guard(m_newFrameMutex);
+        if (rgb_published)
+        {
+            m_rgbPublishedSequence = m_grabbedFrames;
+        }
+        if (mono_published)
+        {
+            m_monoPublishedSequence = m_grabbedFrames;
+        }
     }
-
-    auto res = setOption("BalanceRatioSelector", "Blue", true);
-    res = res && getOption("BalanceRatio", value1);
-    res = res && setOption("BalanceRatioSelector", "Red", true);
-    res = res && getOption("BalanceRatio", value2);
-    *value1 = fromRangeToZeroOne(f, *value1);
-    *value2 = fromRangeToZeroOne(f, *value2);
-    yCDebug(PYLON_CAMERA) << "In 0-1" << *value1;
-    yCDebug(PYLON_CAMERA) << "In 0-1" << *value2;
-    return res;
+    m_newFrame.notify_all();
 }
 
-bool pylonCameraDriver::hasOnOff(int feature, bool* HasOnOff)
+void pylonCameraDriver::waitNewFrame(const std::uint64_t& published_sequence, std::uint64_t last_sequence, double timeout)
 {
-    return hasAuto(feature, HasOnOff);
+    // Only a frame of the same output wakes the consumer up, the other output can be produced from a different frame
+    std::unique_lock<std::mutex> lock(m_newFrameMutex);
+    m_newFrame.wait_for(lock, std::chrono::duration<double>(timeout), [this, &published_sequence, last_sequence]() { return published_sequence > last_sequence || !m_grabThreadRunning; });
 }
 
-bool pylonCameraDriver::setActive(int feature, bool onoff)
+void pylonCameraDriver::stopGrabThread()
 {
-    bool b = false;
-    if (!hasFeature(feature, &b) || !b)
+    bool running = m_grabThreadRunning.exchange(false);
+    // The grab thread returns within a retrieve timeout, the stream is stopped after it: never while it is retrieving
+    if (m_grabThread.joinable())
     {
-        yCError(PYLON_CAMERA) << "Feature" << feature << "not supported!";
-        return false;
+        m_grabThread.join();
     }
-
-    if (!hasOnOff(feature, &b) || !b)
+    if (running)
     {
-        yCError(PYLON_CAMERA) << "Feature" << feature << "does not have OnOff.. call hasOnOff() to know if a specific feature support OnOff mode";
-        return false;
+        // In event mode StopGrabbing waits for the grab thread of pylon to return from the frame handler
+        std::lock_guard<std::mutex> guard(m_mutex);
+        stopCamera();
+        m_newFrame.notify_all();
     }
+}
 
-    std::string val_to_set = onoff ? "Continuous" : "Off";
-
-    switch (feature)
+void pylonCameraDriver::deviceRemoved()
+{
     {
-        case YARP_FEATURE_EXPOSURE:
-            b = setOption("ExposureAuto", val_to_set.c_str(), true);
-            break;
-        case YARP_FEATURE_WHITE_BALANCE:
-            b = setOption("BalanceWhiteAuto", val_to_set.c_str(), true);
-            break;
-        case YARP_FEATURE_GAIN:
-            b = setOption("GainAuto", val_to_set.c_str(), true);
-            break;
-        default:
-            yCError(PYLON_CAMERA) << "Feature" << feature << "not supported!";
-            return false;
+        std::lock_guard<std::mutex> guard(m_watchdogMutex);
+        m_deviceRemoved = true;
     }
-
-    return b;
+    m_watchdogWakeUp.notify_all();
 }
 
-bool pylonCameraDriver::getActive(int feature, bool* isActive)
+bool pylonCameraDriver::isDeviceRemoved() const
 {
-    bool b = false;
-    if (!hasFeature(feature, &b) || !b)
+    // Also a camera whose previous reopen failed half way, it has no device anymore
+    for (auto* camera : cameras())
     {
-        yCError(PYLON_CAMERA) << "Feature" << feature << "not supported!";
-        return false;
+        if (!camera->IsPylonDeviceAttached() || camera->IsCameraDeviceRemoved())
+        {
+            return true;
+        }
     }
+    return false;
+}
 
-    if (!hasOnOff(feature, &b) || !b)
+void pylonCameraDriver::watchdogLoop()
+{
+    // The values written at runtime are taken when the removal is noticed, the reopen replaces the shadow registers
+    std::map<std::string, yarp::os::Value> shadow_registers;
+    bool reconnecting{false};
+    auto period = std::chrono::duration<double>(watchdogPeriod);
+    std::unique_lock<std::mutex> lock(m_watchdogMutex);
+    while (m_watchdogRunning)
     {
-        yCError(PYLON_CAMERA) << "Feature" << feature << "does not have OnOff.. call hasOnOff() to know if a specific feature support OnOff mode";
-        return false;
+        // The removal event wakes it up at once, the polling covers the transport layers without it
+        m_watchdogWakeUp.wait_for(lock, period, [this, reconnecting]() { return !m_watchdogRunning || (m_deviceRemoved && !reconnecting); });
+        if (!m_watchdogRunning)
+        {
+            break;
+        }
+        lock.unlock();
+        if (!reconnecting && isDeviceRemoved())
+        {
+            yCWarning(PYLON_CAMERA) << "Camera" << m_serial_number << "is not available, waiting for it to come back";
+            stopGrabThread();
+            std::lock_guard<std::mutex> guard(m_shadowMutex);
+            shadow_registers = m_shadowRegisters;
+            reconnecting = true;
+        }
+        if (reconnecting && reconnectCamera(shadow_registers))
+        {
+            reconnecting = false;
+        }
+        lock.lock();
+        m_deviceRemoved = reconnecting;
     }
+}
 
-    std::string val_to_get{""};
-
-    switch (feature)
+bool pylonCameraDriver::reconnectCamera(const std::map<std::string, yarp::os::Value>& shadow_registers)
+{
+    double start = yarp::os::Time::now();
+    std::vector<std::pair<Pylon::CInstantCamera*, Pylon::String_t>> removed;
+    for (auto* camera : cameras())
     {
-        case YARP_FEATURE_EXPOSURE:
-            b = getOption("ExposureAuto", val_to_get, true);
-            break;
-        case YARP_FEATURE_WHITE_BALANCE:
-            b = getOption("BalanceWhiteAuto", val_to_get, true);
-            break;
-        case YARP_FEATURE_GAIN:
-            b = getOption("GainAuto", val_to_get, true);
-            break;
-        default:
-            yCError(PYLON_CAMERA) << "Feature" << feature << "not supported!";
+        auto serial_number = camera == m_camera_ptr.get() ? m_serial_number : m_rightSerialNumber;
+        if (!camera->IsPylonDeviceAttached() || camera->IsCameraDeviceRemoved())
+        {
+            if (!m_runtime->isAvailable(serial_number))
+            {
+                return false;
+            }
+            removed.emplace_back(camera, serial_number);
+        }
+    }
+    {
+        // The same camera objects get the new devices: the frame sources and the event handlers stay registered on them
+        std::lock_guard<std::mutex> guard(m_mutex);
+        try
+        {
+            for (auto& camera : removed)
+            {
+                camera.first->DestroyDevice();
+                camera.first->Attach(m_runtime->createDevice(camera.second));
+                camera.first->Open();
+            }
+        }
+        catch (const GenericException& e)
+        {
+            yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot be reopened, error:" << e.GetDescription();
+            return false;
+        }
+        if (!resolveFeatures())
+        {
             return false;
+        }
+        // The queued writes hold the nodes of the old device
+        if (!m_transactions.empty())
+        {
+            yCWarning(PYLON_CAMERA) << "Discarding" << m_transactions.size() << "open transactions of the old device";
+            m_transactions.clear();
+        }
     }
-    if (b)
+    invalidateShadowRegisters();
+    bool chunks_enabled{false};
+    bool ok = configureCamera(m_config, m_pixelFormat, m_chunkMetadata, chunks_enabled);
+    // Then what was written at runtime: the selected entry goes first, the selector is written as any other node
+    beginTransaction();
+    for (const auto& shadow : shadow_registers)
     {
-        if (val_to_get == "Continuous")
+        auto option = shadow.first;
+        auto bracket = option.find('[');
+        if (bracket != std::string::npos)
         {
-            *isActive = true;
+            auto selector = nodeToSelector.at(option.substr(0, bracket));
+            auto entry = option.substr(bracket + 1, option.size() - bracket - 2);
+            option.erase(bracket);
+            setOptionFromValue(selector, yarp::os::Value(entry));
         }
-        else if (val_to_get == "Off")
+        CParameter parameter(getNode(option));
+        if (parameter.IsValid() && parameter.IsWritable())
         {
-            *isActive = false;
+            setOptionFromValue(option, shadow.second);
         }
     }
-    return b;
-}
+    ok = commitTransaction() && ok;
+    if (!ok)
+    {
+        yCWarning(PYLON_CAMERA) << "Camera" << m_serial_number << "reopened, but part of its configuration could not be applied";
+    }
 
-bool pylonCameraDriver::hasAuto(int feature, bool* hasAuto)
-{
-    cameraFeature_id_t f;
-    f = static_cast<cameraFeature_id_t>(feature);
-    if (f < YARP_FEATURE_BRIGHTNESS || f > YARP_FEATURE_NUMBER_OF - 1)
+    setupClockSync(m_camera_ptr.get(), *m_frameSource, m_clock);
+    if (m_stereo)
+    {
+        setupClockSync(m_rightCamera_ptr.get(), *m_rightFrameSource, m_rightClock);
+    }
+    m_firstAcquisition = true;
+    m_pairBroken = false;
+    m_grabThreadRunning = m_acquisitionMode == acquisitionMode::event;
+    if (!startCamera())
     {
         return false;
     }
-
-    *hasAuto = std::find(features_with_auto.begin(), features_with_auto.end(), f) != features_with_auto.end();
-
+    if (m_acquisitionMode == acquisitionMode::thread)
+    {
+        m_grabThreadRunning = true;
+        m_grabThread = std::thread(&pylonCameraDriver::grabLoop, this);
+    }
+    ++m_reconnections;
+    yCInfo(PYLON_CAMERA) << "Camera" << m_serial_number << "reconnected in" << yarp::os::Time::now() - start << "s";
     return true;
 }
 
-bool pylonCameraDriver::hasManual(int feature, bool* hasManual)
+void pylonCameraDriver::stopWatchdog()
 {
-    return hasFeature(feature, hasManual);
+    {
+        std::lock_guard<std::mutex> guard(m_watchdogMutex);
+        m_watchdogRunning = false;
+    }
+    m_watchdogWakeUp.notify_all();
+    if (m_watchdog.joinable())
+    {
+        m_watchdog.join();
+    }
 }
 
-bool pylonCameraDriver::hasOnePush(int feature, bool* hasOnePush)
+template <class Pixel>
+bool pylonCameraDriver::readLatestFrame(pylonTripleBuffer<outputFrame<Pixel>>& frames, yarp::sig::ImageOf<Pixel>& image, std::uint64_t& last_sequence, std::atomic<bool>& image_new)
 {
-    return hasAuto(feature, hasOnePush);
-}
+    if (!m_grabThreadRunning)
+    {
+        yCErrorThrottle(PYLON_CAMERA, 1.0) << "Errors in retrieving images, the acquisition thread is not running";
+        return false;
+    }
 
-bool pylonCameraDriver::setMode(int feature, FeatureMode mode)
-{
-    bool b{false};
-    if (!hasAuto(feature, &b) || !b)
+    bool is_new = frames.update();
+    const auto& frame = frames.readBuffer();
+    if (frame.sequence == 0)
     {
-        yCError(PYLON_CAMERA) << "Feature" << feature << "not supported!";
+        yCDebugThrottle(PYLON_CAMERA, 1.0) << "No frame acquired yet";
         return false;
     }
+    if (!is_new)
+    {
+        yCDebugThrottle(PYLON_CAMERA, 1.0) << "Frame" << frame.sequence << "already returned, repeating it";
+    }
+    image_new = is_new;
+    setLastFrameMetadata(frame.metadata, frame.stamp, frame.sequence, frame.skew);
 
-    switch (mode)
+    // The only copy of this acquisition mode: the handoff from the acquisition thread to the caller
     {
-        case MODE_AUTO:
-            return setActive(feature, true);
-        case MODE_MANUAL:
-            return setActive(feature, false);
-        case MODE_UNKNOWN:
-            return false;
-        default:
-            return false;
+        pylonStageTimer timer(m_stageLatency[stageCopy]);
+        resizeImage(image, frame.image.width(), frame.image.height());
+        memcpy((void*)image.getRawImage(), frame.image.getRawImage(), frame.image.getRawImageSize());
     }
-    return b;
+    m_bytesCopiedPerFrame = frame.bytesCopied + frame.image.getRawImageSize();
+    if (is_new)
+    {
+        frameDelivered(frame.sequence, last_sequence, frame.retrieveTime);
+    }
+    return true;
 }
 
-bool pylonCameraDriver::getMode(int feature, FeatureMode* mode)
+void pylonCameraDriver::frameDelivered(std::uint64_t sequence, std::uint64_t& last_sequence, std::uint64_t retrieve_time)
 {
-    bool b{false};
-    if (!hasAuto(feature, &b) || !b)
+    m_stageLatency[stageTotal].record(pylonLatencyHistogram::now() - retrieve_time);
+    // In sync mode every output retrieves its own frames, the others look like gaps
+    if (m_acquisitionMode != acquisitionMode::sync && last_sequence != 0 && sequence > last_sequence + 1)
     {
-        yCError(PYLON_CAMERA) << "Feature" << feature << "not supported!";
-        return false;
+        m_frameCounters.add(pylonFrameCounters::dropped, sequence - last_sequence - 1);
     }
-    bool get_active{false};
-    b = b && getActive(feature, &get_active);
+    last_sequence = sequence;
+    m_frameCounters.add(pylonFrameCounters::delivered);
+}
 
-    if (b)
+void pylonCameraDriver::resetStats()
+{
+    for (auto& histogram : m_stageLatency)
     {
-        if (get_active)
-        {
-            *mode = MODE_AUTO;
-        }
-        else
+        histogram.reset();
+    }
+    m_frameCounters.reset();
+    {
+        std::lock_guard<std::mutex> guard(m_failureCodesMutex);
+        m_failureCodes.clear();
+    }
+    m_pairSkewHistogram.reset();
+    for (auto* source : {m_frameSource.get(), m_rightFrameSource.get()})
+    {
+        if (source != nullptr)
         {
-            *mode = MODE_MANUAL;
+            source->resetBufferStats();
         }
     }
-    return b;
+    m_statsStartTime = pylonLatencyHistogram::now();
 }
 
-bool pylonCameraDriver::setOnePush(int feature)
+void pylonCameraDriver::fillStats(yarp::os::Bottle& reply)
 {
-    bool b = false;
-    if (!hasOnePush(feature, &b) || !b)
+    static const std::array<const char*, stageCount> stage_names{"retrieve", "convert", "transform", "copy", "total"};
+    double elapsed = 1e-9 * static_cast<double>(pylonLatencyHistogram::now() - m_statsStartTime);
+    auto& fps = reply.addList();
+    fps.addString("fps");
+    fps.addFloat64(elapsed > 0.0 ? static_cast<double>(m_frameCounters.total(pylonFrameCounters::delivered)) / elapsed : 0.0);
+    // Frame counters since the last reset, then over the last stats_window seconds
+    static const std::array<const char*, pylonFrameCounters::counterCount> counter_names{"delivered", "dropped", "skipped", "lost", "incomplete", "failed"};
+    for (size_t i = 0; i < pylonFrameCounters::counterCount; ++i)
     {
-        yCError(PYLON_CAMERA) << "Feature" << feature << "doesn't have OnePush";
-        return false;
+        auto& counter = reply.addList();
+        counter.addString(counter_names[i]);
+        counter.addInt64(static_cast<std::int64_t>(m_frameCounters.total(static_cast<pylonFrameCounters::counter>(i))));
+    }
+    auto& window = reply.addList();
+    window.addString("window");
+    window.addInt64(static_cast<std::int64_t>(m_frameCounters.window()));
+    for (size_t i = 0; i < pylonFrameCounters::counterCount; ++i)
+    {
+        window.addInt64(static_cast<std::int64_t>(m_frameCounters.windowed(static_cast<pylonFrameCounters::counter>(i))));
+    }
+    // Failed and incomplete grabs by pylon error code
+    auto& failure_codes = reply.addList();
+    failure_codes.addString("failure_codes");
+    {
+        std::lock_guard<std::mutex> guard(m_failureCodesMutex);
+        for (const auto& failure : m_failureCodes)
+        {
+            auto& code = failure_codes.addList();
+            code.addInt64(static_cast<std::int64_t>(failure.first));
+            code.addInt64(static_cast<std::int64_t>(failure.second));
+        }
+    }
+    // Since the open, the recording is not restarted by a reset
+    auto& recorded = reply.addList();
+    recorded.addString("recorded");
+    recorded.addInt64(static_cast<std::int64_t>(m_recorder.recordedFrames()));
+    auto& record_dropped = reply.addList();
+    record_dropped.addString("record_dropped");
+    record_dropped.addInt64(static_cast<std::int64_t>(m_recorder.droppedFrames()));
+    auto& reconnections = reply.addList();
+    reconnections.addString("reconnections");
+    reconnections.addInt64(static_cast<std::int64_t>(m_reconnections));
+    // Buffer pools: allocated, waiting to be retrieved (now and peak), frames lost for lack of a free buffer
+    for (auto* source : {m_frameSource.get(), m_rightFrameSource.get()})
+    {
+        pylonBufferStats buffer_stats;
+        if (source == nullptr || !source->bufferStats(buffer_stats))
+        {
+            continue;
+        }
+        auto& buffers = reply.addList();
+        buffers.addString(source == m_rightFrameSource.get() ? "right_buffers" : "buffers");
+        buffers.addInt64(static_cast<std::int64_t>(buffer_stats.buffers));
+        buffers.addInt64(static_cast<std::int64_t>(buffer_stats.readyBuffers));
+        buffers.addInt64(static_cast<std::int64_t>(buffer_stats.peakReadyBuffers));
+        buffers.addInt64(static_cast<std::int64_t>(buffer_stats.underruns));
+    }
+    // Latencies in us
+    for (size_t i = 0; i < stageCount; ++i)
+    {
+        auto& stage = reply.addList();
+        stage.addString(stage_names[i]);
+        stage.addInt64(static_cast<std::int64_t>(m_stageLatency[i].count()));
+        stage.addFloat64(1e-3 * static_cast<double>(m_stageLatency[i].percentile(50.0)));
+        stage.addFloat64(1e-3 * static_cast<double>(m_stageLatency[i].percentile(99.0)));
+        stage.addFloat64(1e-3 * static_cast<double>(m_stageLatency[i].max()));
+    }
+    if (m_stereo)
+    {
+        // Absolute capture time difference of the pairs, us
+        auto& skew = reply.addList();
+        skew.addString("skew");
+        skew.addInt64(static_cast<std::int64_t>(m_pairSkewHistogram.count()));
+        skew.addFloat64(1e-3 * static_cast<double>(m_pairSkewHistogram.percentile(50.0)));
+        skew.addFloat64(1e-3 * static_cast<double>(m_pairSkewHistogram.percentile(99.0)));
+        skew.addFloat64(1e-3 * static_cast<double>(m_pairSkewHistogram.max()));
     }
-
-    b = b && setMode(feature, MODE_AUTO);
-    b = b && setMode(feature, MODE_MANUAL);
-
-    return b;
 }
 
 bool pylonCameraDriver::getImage(yarp::sig::ImageOf<yarp::sig::PixelRgb>& image)
 {
-    std::lock_guard<std::mutex> guard(m_mutex);
-    if (m_camera_ptr->IsGrabbing())
-    {
-        CGrabResultPtr grab_result_ptr;
-        CPylonImage pylon_image;
-        CImageFormatConverter pylon_format_converter;
-        // In case of rotation we need to use BGR coding because we use opencv.
-        pylon_format_converter.OutputPixelFormat = m_rotation != 0.0 ? PixelType_BGR8packed : PixelType_RGB8packed;
-        // Wait for an image and then retrieve it. A timeout of 5000 ms is used.
-        // TODO change the hardcoded 5000 to the exposure time.
-        try
+    pylonAllocationScope allocations(m_allocations);
+    if (m_acquisitionMode == acquisitionMode::sync)
+    {
+        std::lock_guard<std::mutex> guard(m_streamMutex);
+        pylonFrame source_frame;
+        size_t bytes_copied{0};
+        m_rgbImageNew = retrieveFrame(source_frame) && processRgb(source_frame, image, bytes_copied);
+        if (m_rgbImageNew)
         {
-            m_camera_ptr->RetrieveResult(5000, grab_result_ptr, TimeoutHandling_ThrowException);
+            m_bytesCopiedPerFrame = bytes_copied;
+            ++m_grabbedFrames;
+            setLastFrameMetadata(source_frame.metadata, frameStamp(source_frame, m_grabbedFrames), m_grabbedFrames, m_pairSkew);
+            frameDelivered(m_grabbedFrames, m_rgbLastSequence, m_lastRetrieveNs);
         }
-        catch (const Pylon::GenericException& e)
+        return m_rgbImageNew;
+    }
+    // An output is produced from its first request on, that waits for its first frame. In event mode the consumer is woken up
+    // by the frame, not by its own period: without a new frame within two periods the last one is repeated
+    bool first_request = !m_rgbRequested.exchange(true);
+    if (first_request || m_acquisitionMode == acquisitionMode::event)
+    {
+        waitNewFrame(m_rgbPublishedSequence, m_rgbLastSequence, first_request ? 1e-3 * retrieveTimeout() : 2.0 / m_fps);
+    }
+    return readLatestFrame(m_rgbFrames, image, m_rgbLastSequence, m_rgbImageNew);
+}
+
+bool pylonCameraDriver::getImage(yarp::sig::ImageOf<yarp::sig::PixelMono>& image)
+{
+    pylonAllocationScope allocations(m_allocations);
+    if (m_acquisitionMode == acquisitionMode::sync)
+    {
+        std::lock_guard<std::mutex> guard(m_streamMutex);
+        pylonFrame source_frame;
+        size_t bytes_copied{0};
+        m_monoImageNew = retrieveFrame(source_frame) && processMono(source_frame, image, bytes_copied);
+        if (m_monoImageNew)
         {
-            // Error handling.
-            yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot get images error:" << e.GetDescription();
-            return false;
+            m_bytesCopiedPerFrame = bytes_copied;
+            ++m_grabbedFrames;
+            setLastFrameMetadata(source_frame.metadata, frameStamp(source_frame, m_grabbedFrames), m_grabbedFrames, m_pairSkew);
+            frameDelivered(m_grabbedFrames, m_monoLastSequence, m_lastRetrieveNs);
         }
-        // Image grabbed successfully?
-        if (grab_result_ptr && grab_result_ptr->GrabSucceeded())
-        {
-            m_width = grab_result_ptr->GetWidth();
-            m_height = grab_result_ptr->GetHeight();
-            size_t mem_to_wrt = m_width * m_height * image.getPixelSize();
+        return m_monoImageNew;
+    }
+    bool first_request = !m_monoRequested.exchange(true);
+    if (first_request || m_acquisitionMode == acquisitionMode::event)
+    {
+        waitNewFrame(m_monoPublishedSequence, m_monoLastSequence, first_request ? 1e-3 * retrieveTimeout() : 2.0 / m_fps);
+    }
+    return readLatestFrame(m_monoFrames, image, m_monoLastSequence, m_monoImageNew);
+}
 
-            if (m_rotation == -90.0 || m_rotation == 90.0)
-            {
-                std::swap(m_width, m_height);
-            }
+bool pylonCameraDriver::isLastImageNew() const
+{
+    return m_rgbImageNew;
+}
 
-            // TODO Check pixel code
-            image.resize(m_width, m_height);
-            pylon_format_converter.Convert(pylon_image, grab_result_ptr);
-            if (!pylon_image.IsValid())
-            {
-                yCError(PYLON_CAMERA) << "Frame invalid!";
-                return false;
-            }
+bool pylonCameraDriver::isLastRawImageNew() const
+{
+    return m_monoImageNew;
+}
 
-            // For some reason the first frame cannot be converted To be investigated
-            static bool first_acquisition{true};
-            if (first_acquisition)
-            {
-                yCDebug(PYLON_CAMERA) << "Skipping";
-                first_acquisition = false;
-                return false;
-            }
+size_t pylonCameraDriver::getBytesCopiedPerFrame() const
+{
+    return m_bytesCopiedPerFrame;
+}
 
-            if (m_rotation != 0.0)
-            {
-                Mat rotated(grab_result_ptr->GetHeight(), grab_result_ptr->GetWidth(), CV_8UC3, (uint8_t*)pylon_image.GetBuffer());
-                // warpAffine(Mat(grab_result_ptr->GetHeight(), grab_result_ptr->GetWidth(), CV_8UC3, (uint8_t*)pylon_image.GetBuffer()),
-                //             rotated, getRotationMatrix2D( Point( grab_result_ptr->GetWidth()/2, grab_result_ptr->GetHeight()/2 ),
-                //             m_rotation, 1.0 ), rotated.size());
-#if defined USE_CUDA
-                cv::cuda::GpuMat gpu_im;
-                gpu_im.upload(rotated);  // RAM => GPU
+std::uint64_t pylonCameraDriver::getAllocationCount() const
+{
+    return m_allocations;
+}
 
-                // Rotate from 90
-                cv::Size size = rotated.size();
-                cv::cuda::GpuMat gpu_im_rot;
-                // TODO che if the resulting image is W x H or viceversa
-                cv::cuda::rotate(gpu_im, gpu_im_rot, cv::Size(size.height, size.width), m_rotation, size.height - 1, 0, cv::INTER_LINEAR);
+yarp::os::Stamp pylonCameraDriver::getLastInputStamp()
+{
+    std::lock_guard<std::mutex> guard(m_metadataMutex);
+    return m_rgb_stamp;
+}
 
-                gpu_im_rot.download(rotated);  // GPU => RAM
+pylonCameraDriver::frameMetadata pylonCameraDriver::getLastFrameMetadata() const
+{
+    std::lock_guard<std::mutex> guard(m_metadataMutex);
+    return m_lastMetadata;
+}
 
-#else
-                cv::rotate(rotated, rotated, rotationToCVRot.at(m_rotation));
-#endif  // USE_CUDA
-                image.copy(yarp::cv::fromCvMat<yarp::sig::PixelRgb>(rotated));
-            }
-            else
-            {
-                memcpy((void*)image.getRawImage(), pylon_image.GetBuffer(), mem_to_wrt);
-            }
-        }
-        else
-        {
-            yCError(PYLON_CAMERA) << "Acquisition failed";
-            return false;
-        }
-        return true;
-    }
-    else
-    {
-        yCError(PYLON_CAMERA) << "Errors in retrieving images";
-        return false;
-    }
+double pylonCameraDriver::getLastPairSkew() const
+{
+    std::lock_guard<std::mutex> guard(m_metadataMutex);
+    return m_lastPairSkew;
 }
 
 int pylonCameraDriver::height() const
@@ -735,5 +2976,5 @@ int pylonCameraDriver::height() const
 
 int pylonCameraDriver::width() const
 {
-    return m_width;
+    return outputWidth();
 }
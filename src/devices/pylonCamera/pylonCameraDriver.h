@@ -13,18 +13,49 @@
 #include <yarp/dev/DeviceDriver.h>
 #include <yarp/dev/IFrameGrabberControls.h>
 #include <yarp/dev/IFrameGrabberImage.h>
+#include <yarp/dev/IPreciselyTimed.h>
 #include <yarp/dev/IRgbVisualParams.h>
+#include <yarp/os/Bottle.h>
+#include <yarp/os/BufferedPort.h>
 #include <yarp/os/PeriodicThread.h>
+#include <yarp/os/Port.h>
+#include <yarp/os/PortInfo.h>
+#include <yarp/os/PortReader.h>
+#include <yarp/os/PortReport.h>
 #include <yarp/os/Stamp.h>
+#include <yarp/os/Value.h>
 #include <yarp/sig/Matrix.h>
 #include <yarp/sig/all.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <cstring>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <typeinfo>
+#include <vector>
+
+#if defined USE_CUDA
+#include <opencv2/core/cuda.hpp>
+#endif  // USE_CUDA
+
+#include "pylonClockSync.h"
+#include "pylonFrameCounters.h"
+#include "pylonFrameRecorder.h"
+#include "pylonFrameSource.h"
+#include "pylonHeapCounter.h"
+#include "pylonImageKernels.h"
+#include "pylonLatencyHistogram.h"
+#include "pylonReplaySource.h"
+#include "pylonRuntime.h"
+#include "pylonTripleBuffer.h"
 
 /**
  * @ingroup dev_impl_media
@@ -39,7 +70,12 @@
  * The parameters accepted by this device are:
  * | Parameter name | SubParameter   | Type    | Units          | Default Value | Required                    | Description                                                       | Notes |
  * |:--------------:|:--------------:|:-------:|:--------------:|:-------------:|:--------------------------: |:-----------------------------------------------------------------:|:-----:|
- * | serial_number  |      -         | int     | -              |   -           | Yes                         | Serial number of the camera to be opened                          |  |
+ * | serial_number  |      -         | int     | -              |   -           | Yes                         | Serial number of the camera to be opened                          | Not required with replay_file |
+ * | right_serial_number | -         | int     | -              |   -           | No                          | Serial number of the right camera of a stereo pair, serial_number is the left one | Both cameras get
+ * the same configuration, every later write goes to both. They are software triggered together and the images are the left and right frames side by side, from the same trigger. Not available with replay_file and record_file |
+ * | replay_file    |      -         | string  | -              |   -           | No                          | Recording replayed instead of opening a camera                    | The file is memory mapped and its
+ * frames go through the same pipeline with their original timestamps and pacing. Resolution and pixel format are the recorded ones, the camera parameters are not available |
+ * | replay_loop    |      -         | bool    | -              |   true        | No                          | Restart the replay from the first frame at the end of the recording | Without loop the stream stops at the end |
  * | period         |      -         | double  | s              |   0.0333      | No                          | Refresh period of acquistion from the camera in s                 | The cameras has a
  * value cap for the acquisition framerate, check the documentation | | rotation       |      -         | double  | degrees        |   0.0         | No                          | Rotation applied from
  * the center of the image                     | Depending the size requested some rotations are not allowed. The rotation worse the performance of the device. Allowed values: 0.0, 90.0, -90.0,
@@ -47,6 +83,38 @@
  * has a value cap for the width of the image that can provide, check the documentation. Zero or negative value not accepted | | height         |      -         | uint    | pixel          |   480 | No
  * | Height of the images requested to the camera                      | The cameras has a value cap for the width of the image that can provide, check the documentation. Zero or negative value not
  * accepted |
+ * | acquisition_mode |      -         | string  | -              |   thread      | No                          | How frames are acquired from the camera                           | `thread`: an internal thread
+ * grabs and converts the frames, getImage() returns the newest one without waiting. `sync`: the frame is grabbed and converted inside getImage(). `event`: the
+ * frames are converted by the grab thread of pylon as soon as they arrive, getImage() waits for the next one (at most two periods). With thread and event the RGB and the raw outputs are produced from their
+ * first getImage(), that waits for the first frame |
+ * | acquisition_profile | -         | string  | -              |   balanced    | No                          | Grab strategy and buffers of the camera                           | `low_latency`: UpcomingImage, 4
+ * buffers, the frame grabbed after the request (LatestImageOnly on USB cameras, that do not support it). `balanced`: LatestImages with an output queue of 1, 10 buffers, the older frames are
+ * overwritten. `lossless`: OneByOne, 32 buffers, every frame is delivered in order (with record_file or the sync acquisition_mode) |
+ * | buffer_memory  |      -         | uint    | MB             |   128         | No                          | Memory budget of the camera buffers                               | Caps the buffers of the profile
+ * on the payload size, shared by the cameras of a stereo pair |
+ * | reconnect      |      -         | bool    | -              |   true        | No                          | Reopen the camera when it comes back after a removal               | The configuration and the values
+ * written at runtime are applied again, the acquisition restarts by itself |
+ * | stats_window   |      -         | uint    | s              |   10          | No                          | Window of the recent frame counters of `stats`                     | From 1 to 60 |
+ * | pixel_format   |      -         | string  | -              |   default     | No                          | Pixel format sent by the camera                                   | `default`: the camera format is
+ * not changed and pylon converts it. `bayer_rg8`, `yuv422`: the camera sends BayerRG8 or YCbCr422_8 and the driver converts it with SIMD kernels. `mono8`: the camera
+ * sends Mono8. With `mono8` and `bayer_rg8` the raw interface (IFrameGrabberImageRaw) publishes the sensor data without any conversion |
+ * | feature_file   |      -         | string  | -              |   -           | No                          | Pylon feature file (.pfs) loaded at open in a single operation     | It replaces the default writes,
+ * only the parameters given explicitly (width, height, period, pixel_format, rotation, camera_features) are written on top of it. If missing the configuration is applied, the rpc `save` creates it |
+ * | user_set       |      -         | string  | -              |   -           | No                          | User set of the camera (e.g. UserSet1) loaded at open              | As feature_file, but stored in the
+ * camera. Not allowed together with feature_file |
+ * | camera_features |      -        | group   | -              |   -           | No                          | GenICam nodes written at startup, one `name value` pair per line   | Applied in the same transaction
+ * of the other parameters, after them |
+ * | rpc_port       |      -         | string  | -              |   -           | No                          | Name of the rpc port of the device                                | Commands: `set <node> <value>`,
+ * `get <node>`, `begin`, `commit`, `abort`, `save`, `refresh`, `stats`, `stats reset`, `help`. The `set` between `begin` and `commit` are applied together with at most one restart of the stream |
+ * | chunk_metadata |      -         | bool    | -              |   true        | No                          | Attach exposure time, gain, frame id and timestamp chunks to every frame | The missing chunks are
+ * skipped, see getLastFrameMetadata() |
+ * | record_file    |      -         | string  | -              |   -           | No                          | File recording the raw frames of the camera                       | Lossless, replayable with
+ * replay_file. The frames are copied in a preallocated buffer and written by a background thread, the acquisition never waits: the frames that do not fit are dropped and counted (`stats`) |
+ * | record_buffer_frames | -        | int     | frames         |   32          | No                          | Frames of the recording buffer                                    | Sized on the payload of the camera |
+ * | record_direct_io |    -         | bool    | -              |   false       | No                          | Write the recording with O_DIRECT, bypassing the page cache       | Falls back to buffered writes if the
+ * file system does not support it |
+ * | metadata_port  |      -         | string  | -              |   -           | No                          | Port publishing the chunk data of every new frame returned by getImage() | Bottle of `(name value)`
+ * pairs: frame_id, timestamp, exposure_time, gain, and skew for a stereo pair |
  *
  */
 
@@ -55,7 +123,14 @@ namespace
 YARP_LOG_COMPONENT(PYLON_CAMERA, "yarp.device.pylonCamera")
 }
 
-class pylonCameraDriver : public yarp::dev::DeviceDriver, public yarp::dev::IFrameGrabberControls, public yarp::dev::IFrameGrabberImage, public yarp::dev::IRgbVisualParams
+class pylonCameraDriver : public yarp::dev::DeviceDriver,
+                          public yarp::dev::IFrameGrabberControls,
+                          public yarp::dev::IFrameGrabberImage,
+                          public yarp::dev::IFrameGrabberImageRaw,
+                          public yarp::dev::IRgbVisualParams,
+                          public yarp::dev::IPreciselyTimed,
+                          public yarp::os::PortReader,
+                          public yarp::os::PortReport
 {
    private:
     using Stamp = yarp::os::Stamp;
@@ -63,6 +138,9 @@ class pylonCameraDriver : public yarp::dev::DeviceDriver, public yarp::dev::IFra
     using FlexImage = yarp::sig::FlexImage;
 
    public:
+    // Camera state in effect for a frame, parsed from the chunks attached to it. A field is valid only if its chunk was received
+    using frameMetadata = pylonFrameMetadata;
+
     pylonCameraDriver() = default;
     ~pylonCameraDriver() override = default;
 
@@ -104,95 +182,312 @@ class pylonCameraDriver : public yarp::dev::DeviceDriver, public yarp::dev::IFra
     int height() const override;
     int width() const override;
 
+    // IFrameGrabberImageRaw
+    bool getImage(yarp::sig::ImageOf<yarp::sig::PixelMono>& image) override;
+
+    // IPreciselyTimed: middle of the exposure of the last image, camera timestamp mapped to the host clock
+    yarp::os::Stamp getLastInputStamp() override;
+
+    // True if the last RGB image returned by getImage() was never returned before, false if it is a repeat
+    bool isLastImageNew() const;
+    // The same for the last raw (mono) image, each output has its own
+    bool isLastRawImageNew() const;
+    // Bytes moved by plain memory copies (conversion and rotation excluded) to produce the last image
+    size_t getBytesCopiedPerFrame() const;
+    // Heap allocations made by the acquisition pipeline (retrieve, conversion, handoff), it must not grow after the warm-up.
+    // Counted only by the executables built with PYLON_COUNT_ALLOCATIONS, that replace the global operator new
+    // (pylonSoakTest). In the plugin it always returns zero, whatever the pipeline allocates: it is not a runtime check
+    std::uint64_t getAllocationCount() const;
+    // Chunk data of the frame returned by the last getImage()
+    frameMetadata getLastFrameMetadata() const;
+    // Stereo pair: capture time of the right frame minus the left one (s) of the last getImage(), zero with a single camera
+    double getLastPairSkew() const;
+
+    // Parameter transactions: between begin and commit the node writes are validated and queued, the commit applies them
+    // in order with at most one restart of the stream. A transaction belongs to the calling thread (an rpc connection),
+    // the writes of the other callers are not queued in it. Transactions can be nested, only the outermost commit applies
+    // and an abort discards the writes of the innermost level only.
+    void beginTransaction();
+    bool commitTransaction();
+    void abortTransaction();
+    // Drops the shadow registers, the next reads go to the camera
+    void invalidateShadowRegisters();
+    // Writes a node by name, the type of the value is taken from the node (float, integer, boolean, enumeration, string)
+    bool setOptionFromValue(const std::string& option, const yarp::os::Value& value);
+
+    // PortReader, commands received on the rpc port
+    bool read(yarp::os::ConnectionReader& connection) override;
+    // PortReport, discards the transaction left open by a closed rpc connection
+    void report(const yarp::os::PortInfo& info) override;
+
    private:
+    enum class acquisitionMode
+    {
+        sync,
+        thread,
+        event
+    };
+
+    // Stages of the acquisition pipeline with a latency histogram. total is the age of the frame when getImage() returns it
+    enum stage
+    {
+        stageRetrieve,
+        stageConvert,
+        stageTransform,
+        stageCopy,
+        stageTotal,
+        stageCount
+    };
+
+    // Typed handles of the nodes behind a YARP feature, invalid if the camera does not have the node
+    struct featureHandles
+    {
+        const char* valueNode{nullptr};
+        const char* autoNode{nullptr};
+        Pylon::CFloatParameter value;
+        Pylon::CEnumParameter autoMode;
+    };
+
+    struct pendingWrite
+    {
+        std::string option;
+        GenApi::INode* node;
+        yarp::os::Value value;
+        std::function<bool(GenApi::INode*)> write;
+    };
+
+    // Writes queued by a caller, each nested begin marks where its level starts
+    struct transaction
+    {
+        std::vector<size_t> marks;
+        std::vector<pendingWrite> writes;
+        std::string rpcSource;  // the rpc connection that began it, empty for the direct callers
+    };
+
+    // Timestamp counter of a camera mapped to the host clock
+    struct cameraClock
+    {
+        pylonClockSync sync;
+        Pylon::CCommandParameter latch;
+        Pylon::CIntegerParameter latchValue;
+        double lastLatchTime{0.0};
+    };
+
+    template <class Pixel>
+    struct outputFrame
+    {
+        yarp::sig::ImageOf<Pixel> image;
+        std::uint64_t sequence{0};
+        frameMetadata metadata;
+        yarp::os::Stamp stamp;
+        double skew{0.0};  // s, stereo pairs only
+        std::uint64_t retrieveTime{0};  // ns, steady clock
+        size_t bytesCopied{0};
+    };
+
     // method
     // inline bool setParams();
     bool setFramerate(const float _fps);
     template <class T>
     bool setOption(const std::string& option, T value, bool isEnum = false)
+    {
+        auto resolve_node = [this, &option]() { return getNode(option); };
+        if constexpr (std::is_same<T, const char*>::value)
+        {
+            // The string may not outlive the call if the write is queued
+            std::string string_value{value};
+            return applyWrite(option, resolve_node, toShadowValue(value), [string_value, isEnum](GenApi::INode* node) { return writeOption(node, string_value.c_str(), isEnum); });
+        }
+        else
+        {
+            return applyWrite(option, resolve_node, toShadowValue(value), [value, isEnum](GenApi::INode* node) { return writeOption(node, value, isEnum); });
+        }
+    }
+
+    // Writes the node, or queues the write inside a transaction. Most of the parameters can be written while grabbing,
+    // only the locked ones need a restart of the stream. The node is resolved with m_mutex locked, the reconnection
+    // replaces the device (and its nodes) under the same lock
+    template <class Resolve, class Write>
+    bool applyWrite(const std::string& option, Resolve resolve_node, const yarp::os::Value& shadow_value, Write write)
     {
         std::lock_guard<std::mutex> guard(m_mutex);
-        // in some cases it is not used, suppressing the warning
-        YARP_UNUSED(isEnum);
+        auto* node = resolve_node();
+        if (node == nullptr)
+        {
+            yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "has no" << option << "node";
+            return false;
+        }
+        auto caller = m_transactions.find(std::this_thread::get_id());
+        if (caller != m_transactions.end())
+        {
+            yCDebug(PYLON_CAMERA) << "Queueing" << option << "to" << shadow_value.toString();
+            caller->second.writes.push_back({option, node, shadow_value, write});
+            return true;
+        }
         bool ok{true};
-        auto& node_map = m_camera_ptr->GetNodeMap();
-        stopCamera();
+        bool restart = isLockedWhileGrabbing(node) || flushesFrames(option);
+        if (!restart && !Pylon::CParameter(node).IsWritable())
+        {
+            // Locked by another node, not by the stream: the write fails without touching the stream
+            yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot set" << option << "to:" << shadow_value.toString() << "the node is not writable now";
+            return false;
+        }
+        if (restart)
+        {
+            yCDebug(PYLON_CAMERA) << option << "cannot be written while grabbing, or changes the frames in flight, restarting the stream";
+            stopCamera();
+        }
         try
         {
-            yCDebug(PYLON_CAMERA) << "Setting " << option << "to" << value;
-            if constexpr (std::is_same<T, float>::value || std::is_same<T, double>::value)
-            {
-                Pylon::CFloatParameter(node_map, option.c_str()).SetValue(value);
-            }
-            else if constexpr (std::is_same<T, bool>::value)
+            yCDebug(PYLON_CAMERA) << "Setting " << option << "to" << shadow_value.toString();
+            ok = write(node);
+            if (ok)
             {
-                Pylon::CBooleanParameter(node_map, option.c_str()).SetValue(value);
+                writeShadow(option, shadow_value);
+                ok = mirrorWrite(option, shadow_value);
             }
-            else if constexpr (std::is_same<T, int>::value)
-            {
-                Pylon::CIntegerParameter(node_map, option.c_str()).SetValue(value);
-            }
-            else if constexpr (std::is_same<T, const char*>::value)
+        }
+        catch (const Pylon::GenericException& e)
+        {
+            // Error handling.
+            yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot set" << option << "to:" << shadow_value.toString() << "error:" << e.GetDescription();
+            ok = false;
+        }
+        if (ok)
+        {
+            writeApplied(option, shadow_value);
+        }
+        return (!restart || startCamera()) && ok;
+    }
+
+    // Writes the node, throws the pylon exceptions
+    template <class T>
+    static bool writeOption(GenApi::INode* node, T value, bool isEnum)
+    {
+        // in some cases it is not used, suppressing the warning
+        YARP_UNUSED(isEnum);
+        if constexpr (std::is_same<T, float>::value || std::is_same<T, double>::value)
+        {
+            Pylon::CFloatParameter(node).SetValue(value);
+        }
+        else if constexpr (std::is_same<T, bool>::value)
+        {
+            Pylon::CBooleanParameter(node).SetValue(value);
+        }
+        else if constexpr (std::is_same<T, int>::value)
+        {
+            Pylon::CIntegerParameter(node).SetValue(value);
+        }
+        else if constexpr (std::is_same<T, const char*>::value)
+        {
+            if (isEnum)
             {
-                if (isEnum)
-                {
-                    Pylon::CEnumParameter(node_map, option.c_str()).SetValue(value);
-                }
-                else
-                {
-                    Pylon::CStringParameter(node_map, option.c_str()).SetValue(value);
-                }
+                Pylon::CEnumParameter(node).SetValue(value);
             }
             else
             {
-                yCError(PYLON_CAMERA) << "Option" << option << "has a type not supported, type" << typeid(T).name();
-                startCamera();
-                return false;
+                Pylon::CStringParameter(node).SetValue(value);
             }
         }
-        catch (const Pylon::GenericException& e)
+        else
         {
-            // Error handling.
-            yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "cannot set" << option << "to:" << value << "error:" << e.GetDescription();
-            ok = false;
+            yCError(PYLON_CAMERA) << "Option has a type not supported, type" << typeid(T).name();
+            return false;
         }
-        return startCamera() && ok;
+        return true;
+    }
+
+    template <class T>
+    static yarp::os::Value toShadowValue(T value)
+    {
+        if constexpr (std::is_same<T, float>::value || std::is_same<T, double>::value)
+        {
+            return yarp::os::Value(static_cast<double>(value));
+        }
+        else if constexpr (std::is_same<T, bool>::value || std::is_same<T, int>::value)
+        {
+            return yarp::os::Value(static_cast<int>(value));
+        }
+        else if constexpr (std::is_same<T, const char*>::value)
+        {
+            return yarp::os::Value(std::string(value));
+        }
+        return yarp::os::Value();
     }
 
     template <class T>
     bool getOption(const std::string& option, T& value, bool isEnum = false)
     {
-        auto& node_map = m_camera_ptr->GetNodeMap();
         // in some cases it is not used, suppressing the warning
         YARP_UNUSED(isEnum);
+        // Served from the shadow registers when possible, without going to the camera
+        yarp::os::Value cached;
+        if (readShadow(option, cached))
+        {
+            if constexpr (std::is_same<T, float*>::value || std::is_same<T, double*>::value)
+            {
+                *value = cached.asFloat64();
+            }
+            else if constexpr (std::is_same<T, bool*>::value)
+            {
+                *value = cached.asBool();
+            }
+            else if constexpr (std::is_same<T, int*>::value)
+            {
+                *value = cached.asInt32();
+            }
+            else if constexpr (std::is_same<T, std::string>::value)
+            {
+                value = cached.asString();
+            }
+            else
+            {
+                yCError(PYLON_CAMERA) << "Option" << option << "has a type not supported, type" << typeid(T).name();
+                return false;
+            }
+            return true;
+        }
+        // Not served from the shadow registers: the node is read with m_mutex locked, as the reconnection replaces it
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto* node = getNode(option);
+        if (node == nullptr)
+        {
+            yCError(PYLON_CAMERA) << "Camera" << m_serial_number << "has no" << option << "node";
+            return false;
+        }
         try
         {
             if constexpr (std::is_same<T, float*>::value || std::is_same<T, double*>::value)
             {
-                *value = Pylon::CFloatParameter(node_map, option.c_str()).GetValue();
+                *value = Pylon::CFloatParameter(node).GetValue();
                 yCDebug(PYLON_CAMERA) << "Getting" << option << "value:" << *value;
+                writeShadow(option, toShadowValue(*value));
             }
             else if constexpr (std::is_same<T, bool*>::value)
             {
-                *value = Pylon::CBooleanParameter(node_map, option.c_str()).GetValue();
+                *value = Pylon::CBooleanParameter(node).GetValue();
                 yCDebug(PYLON_CAMERA) << "Getting" << option << "value:" << *value;
+                writeShadow(option, toShadowValue(*value));
             }
             else if constexpr (std::is_same<T, int*>::value)
             {
-                *value = Pylon::CIntegerParameter(node_map, option.c_str()).GetValue();
+                *value = Pylon::CIntegerParameter(node).GetValue();
                 yCDebug(PYLON_CAMERA) << "Getting" << option << "value:" << *value;
+                writeShadow(option, toShadowValue(*value));
             }
             else if constexpr (std::is_same<T, std::string>::value)
             {
                 if (isEnum)
                 {
-                    value = Pylon::CEnumParameter(node_map, option.c_str()).GetValue();
+                    value = Pylon::CEnumParameter(node).GetValue();
                     yCDebug(PYLON_CAMERA) << "Getting" << option << "value:" << value;
+                    writeShadow(option, yarp::os::Value(value));
                 }
                 else
                 {
-                    value = Pylon::CStringParameter(node_map, option.c_str()).GetValue();
+                    value = Pylon::CStringParameter(node).GetValue();
                     yCDebug(PYLON_CAMERA) << "Getting" << option << "value:" << value;
+                    writeShadow(option, yarp::os::Value(value));
                 }
             }
             else
@@ -210,21 +505,256 @@ class pylonCameraDriver : public yarp::dev::DeviceDriver, public yarp::dev::IFra
         return true;
     }
 
+    // Shadow registers: last known value of the nodes, filled on write and on read
+    // The selected entry of the nodes behind a selector is the current one if not given
+    bool readShadow(const std::string& option, yarp::os::Value& value, const std::string& selected_entry = "");
+    void writeShadow(const std::string& option, const yarp::os::Value& value);
+    void eraseShadow(const std::string& option);
+    std::string shadowKey(const std::string& option, const std::string& selected_entry = "") const;
+    bool getBalanceRatio(const char* selector, double* value);
+
+    // Node of the camera, nullptr if it does not exist or if there is no camera (replay)
+    GenApi::INode* getNode(const std::string& option) const;
+    bool openCamera(yarp::os::Searchable& config, const std::string& pixel_format, bool chunk_metadata);
+    // The writes of the configuration to the opened cameras, applied again when they come back after a removal
+    bool configureCamera(yarp::os::Searchable& config, const std::string& pixel_format, bool chunk_metadata, bool& chunks_enabled);
+    bool openReplay(const std::string& path, bool loop);
+    bool openRightCamera();
+    // The opened cameras, the right one of a stereo pair included
+    std::vector<Pylon::CInstantCamera*> cameras() const;
+    // Persisted configurations: a pylon feature file (.pfs) or a user set of the camera
+    static bool isFeatureFile(const std::string& target);
+    // Loads the configured feature_file or user_set, loaded is false if none (or the file does not exist yet)
+    bool loadCameraSettings(bool& loaded);
+    bool saveCameraSettings(const std::string& target);
+    // Writes the same value to the right camera of a stereo pair, by node name. Throws the pylon exceptions
+    bool mirrorWrite(const std::string& option, const yarp::os::Value& value);
+    // Fires the software trigger of both cameras of a stereo pair, grabLoop() paces it at the frame rate. False if
+    // the pair had to be restarted and could not be. Called with m_streamMutex locked
+    bool triggerPair(unsigned int timeout_ms);
+    bool setSensorResolution(int width, int height);
+    // Configured size of the sensor, the output one follows from the rotation until the first frame gives it
+    void setSensorSize(std::uint32_t width, std::uint32_t height);
+    // Width of the images returned by getImage(), the two frames side by side for a stereo pair
+    uint32_t outputWidth() const;
+    // Stop and restart the stream, serialized with the retrieve through m_streamMutex
     bool startCamera();
+    // Largest frame the camera sends with its current settings (PayloadSize)
+    size_t maxFrameSize() const;
     bool stopCamera();
+    // The same without m_streamMutex, for the retrieve that already holds it
+    bool startSources();
+    void stopSources();
+    // True if the node is read-only because the camera is grabbing: not writable now, and one of the nodes locked by the stream (e.g. Width, Height, PixelFormat)
+    bool isLockedWhileGrabbing(GenApi::INode* node);
+    // True if the node changes how the frames already captured must be processed, the restart of the stream drops them
+    bool flushesFrames(const std::string& option) const;
+    // State derived from a node, updated once the write has been applied to the camera. Called with m_mutex locked
+    void writeApplied(const std::string& option, const yarp::os::Value& value);
+    // Begins a transaction of the calling thread, owned by the given rpc connection if not empty
+    void beginTransaction(const std::string& rpc_source);
+    // Feature nodes, through the handles resolved at open. They are used with m_mutex locked, a reconnection attaches
+    // them again to the new device under the same lock
+    bool resolveFeatures();
+    bool setFeatureValue(cameraFeature_id_t feature, double value);
+    bool getFeatureValue(cameraFeature_id_t feature, double* value);
+    bool setAutoMode(cameraFeature_id_t feature, const char* mode);
+    bool getAutoMode(cameraFeature_id_t feature, std::string& mode);
+    bool hasAutoMode(cameraFeature_id_t feature);
+    bool selectBalanceRatio(const char* selector);
+    // Writes the sensor flips of the wanted rotation and mirroring, false if the camera did not accept them. The images
+    // are correctly oriented in any case: the host transform does what the sensor flips do not
+    bool applyOrientation();
+    // Host transform of the wanted orientation with the current sensor flips. Called with m_mutex locked
+    void updateHostTransform();
+    bool retrieveFrame(pylonFrame& frame);
+    // A few frame intervals: the period, or the exposure time when it is longer
+    unsigned int retrieveTimeout() const;
+    // Frames skipped or lost before a grab result, and the failure of the result itself
+    void countFrame(const pylonFrame& frame);
+    // Bookkeeping of a new frame (clock, counters, recording), false if it must not be processed
+    bool frameArrived(const pylonFrame& frame);
+    // Event mode: called by the grab thread of pylon with every frame
+    void frameGrabbed(bool succeeded, const pylonFrame& frame);
+    // Converts the frame into the requested outputs, hands them to getImage() and wakes it up
+    void publishFrame(const pylonFrame& source_frame);
+    // Waits for a frame of an output newer than last_sequence, at most timeout s
+    void waitNewFrame(const std::uint64_t& published_sequence, std::uint64_t last_sequence, double timeout);
+    bool enableChunks();
+    void setLastFrameMetadata(const frameMetadata& metadata, const yarp::os::Stamp& stamp, std::uint64_t sequence, double skew);
+    void setupClockSync(Pylon::CInstantCamera* camera, const pylonFrameSource& source, cameraClock& clock);
+    void updateClockSync(cameraClock& clock, const pylonFrame& frame, double retrieve_time);
+    yarp::os::Stamp frameStamp(const pylonFrame& frame, std::uint64_t sequence);
+    // Size of the frame once rotated, the processing is sized on it and not on m_width/m_height that can change meanwhile
+    void frameOutputSize(const pylonFrame& frame, size_t& width, size_t& height) const;
+    // The whole output image: the frame, or the left frame and m_rightFrame side by side
+    bool processRgb(const pylonFrame& frame, yarp::sig::ImageOf<yarp::sig::PixelRgb>& image, size_t& bytes_copied);
+    bool processMono(const pylonFrame& frame, yarp::sig::ImageOf<yarp::sig::PixelMono>& image, size_t& bytes_copied);
+    // The frame at column of the output image
+    bool processRgbAt(const pylonFrame& frame, yarp::sig::ImageOf<yarp::sig::PixelRgb>& image, size_t column, size_t& bytes_copied);
+    bool processMonoAt(const pylonFrame& frame, yarp::sig::ImageOf<yarp::sig::PixelMono>& image, size_t column, size_t& bytes_copied);
+    template <class Pixel>
+    bool readLatestFrame(pylonTripleBuffer<outputFrame<Pixel>>& frames, yarp::sig::ImageOf<Pixel>& image, std::uint64_t& last_sequence, std::atomic<bool>& image_new);
+    void frameDelivered(std::uint64_t sequence, std::uint64_t& last_sequence, std::uint64_t retrieve_time);
+    void resetStats();
+    void fillStats(yarp::os::Bottle& reply);
+    void grabLoop();
+    void allocateBuffers();
+    void resizeImage(yarp::sig::Image& image, size_t width, size_t height);
+    void resizeBuffer(std::vector<std::uint8_t>& buffer, size_t size);
+    void setConverterPadding(Pylon::CImageFormatConverter& converter, size_t& current_padding, size_t padding);
+    void convertFrame(const pylonFrame& frame, std::uint8_t* dst, size_t dst_size, size_t dst_padding);
+    // True if convertFrame() uses the host kernels, that write only the pixels and leave the row padding untouched
+    bool convertsOnHost(const pylonFrame& frame) const;
+    void reportAllocation(const char* buffer_name);
+    void stopGrabThread();
+    // Device removal: signaled by pylon (and polled), the watchdog reopens the cameras when they are back
+    class removalHandler;
+    void deviceRemoved();
+    bool isDeviceRemoved() const;
+    void watchdogLoop();
+    // Reopens the removed cameras, applies the configuration and then the values written at runtime, and restarts the acquisition
+    bool reconnectCamera(const std::map<std::string, yarp::os::Value>& shadow_registers);
+    void stopWatchdog();
 
     mutable std::mutex m_mutex;
+    // Serializes the retrieve of the frames with the stop and the restart of the stream. Taken after m_mutex, that the
+    // acquisition never takes: the parameters stay accessible while a frame is awaited
+    std::mutex m_streamMutex;
 
     yarp::os::Stamp m_rgb_stamp;
     mutable std::string m_lastError{""};
     bool m_verbose{false};
     bool m_initialized{false};
-    float m_fps{30.0};
+    std::atomic<float> m_fps{30.0};
     double m_rotation{0.0};  // degrees
-    uint32_t m_width{640};
-    uint32_t m_height{480};
+    // Size of the images of one camera, the acquisition side updates it with every frame while any thread reads it
+    std::atomic<uint32_t> m_width{640};
+    std::atomic<uint32_t> m_height{480};
+    // Configured Width and Height of the sensor, before the rotation: applied again by a reconnection
+    std::atomic<uint32_t> m_sensorWidth{640};
+    std::atomic<uint32_t> m_sensorHeight{480};
     Pylon::String_t m_serial_number{""};
-    std::unique_ptr<Pylon::CInstantCamera> m_camera_ptr;
+    std::shared_ptr<pylonRuntime> m_runtime;  // released after the cameras
+    std::string m_featureFile{""};
+    std::string m_userSet{""};
+    // Configuration given to open, applied again after a removal of the camera
+    yarp::os::Property m_config;
+    std::string m_pixelFormat{"default"};
+    bool m_chunkMetadata{true};
+    std::atomic<double> m_exposureTime{0.0};  // us, of the last frame or write, for the retrieve timeout
+    std::unique_ptr<Pylon::CInstantCamera> m_camera_ptr;  // null while replaying a recording
+    std::unique_ptr<pylonFrameSource> m_frameSource;
     bool m_rotationWithCrop{false};
+    std::atomic<bool> m_mirror{false};
+    bool m_cameraFlips{false};  // the sensor can flip its readout (ReverseX/ReverseY)
+    // Flips of the sensor readout as last written to the camera, guarded by m_mutex
+    bool m_sensorReverseX{false};
+    bool m_sensorReverseY{false};
+    // The same as pylonRecording::sensorFlip bits, read by the acquisition
+    std::atomic<std::uint32_t> m_sensorFlips{0};
+    pylonGrabSettings m_grabSettings;
+
+    std::array<featureHandles, YARP_FEATURE_NUMBER_OF> m_features;
+    // One bit per feature whose value (auto mode) node is valid, set with the handles: checked without m_mutex
+    static_assert(YARP_FEATURE_NUMBER_OF <= 64, "one bit per feature");
+    std::atomic<std::uint64_t> m_validValues{0};
+    std::atomic<std::uint64_t> m_validAutoModes{0};
+    Pylon::CEnumParameter m_balanceRatioSelector;
+
+    // Open parameter transactions of each calling thread, guarded by m_mutex
+    std::map<std::thread::id, transaction> m_transactions;
+    yarp::os::Port m_rpcPort;
+
+    // Shadow registers, the key of the nodes behind a selector contains the selected entry, e.g. BalanceRatio[Red]
+    std::mutex m_shadowMutex;
+    std::map<std::string, yarp::os::Value> m_shadowRegisters;
+
+    // Acquisition thread
+    acquisitionMode m_acquisitionMode{acquisitionMode::thread};
+    std::thread m_grabThread;
+    std::atomic<bool> m_grabThreadRunning{false};
+    pylonTripleBuffer<outputFrame<yarp::sig::PixelRgb>> m_rgbFrames;
+    pylonTripleBuffer<outputFrame<yarp::sig::PixelMono>> m_monoFrames;
+    std::atomic<bool> m_rgbRequested{false};
+    std::atomic<bool> m_monoRequested{false};
+    std::mutex m_newFrameMutex;
+    std::condition_variable m_newFrame;
+    // Sequence of the last frame published by each output, guarded by m_newFrameMutex
+    std::uint64_t m_rgbPublishedSequence{0};
+    std::uint64_t m_monoPublishedSequence{0};
+    std::uint64_t m_grabbedFrames{0};
+    // Of the last image returned by each output
+    std::atomic<bool> m_rgbImageNew{false};
+    std::atomic<bool> m_monoImageNew{false};
+    bool m_firstAcquisition{true};
+
+    // Per-frame chunk data
+    mutable std::mutex m_metadataMutex;
+    frameMetadata m_lastMetadata;
+    double m_lastPairSkew{0.0};
+    std::uint64_t m_lastMetadataSequence{0};
+    yarp::os::BufferedPort<yarp::os::Bottle> m_metadataPort;
+
+    // Raw frames recorded by the side retrieving them
+    pylonFrameRecorder m_recorder;
+
+    // Camera clock to host clock, used only by the side retrieving the frames
+    cameraClock m_clock;
+    double m_lastRetrieveTime{0.0};
+
+    // Right camera of a stereo pair, it follows the configuration of the left one (m_camera_ptr)
+    bool m_stereo{false};
+    Pylon::String_t m_rightSerialNumber{""};
+    std::unique_ptr<Pylon::CInstantCamera> m_rightCamera_ptr;
+    std::unique_ptr<pylonFrameSource> m_rightFrameSource;
+    pylonFrame m_rightFrame;  // right half of the pair returned by the last retrieveFrame()
+    cameraClock m_rightClock;
+    double m_rightRetrieveTime{0.0};
+    double m_pairSkew{0.0};  // s, right capture time minus left one
+    bool m_pairBroken{false};  // one half of the last pair has been lost
+    std::chrono::steady_clock::time_point m_nextTrigger;  // of a pair in thread mode, grab thread only
+
+    // Per-frame resources, created at open and reused by every frame
+    Pylon::CImageFormatConverter m_formatConverter;
+    size_t m_converterPadding{0};
+    bool m_hostConversion{false};
+    pylonImageKernels::bayerToRgbFunction m_bayerToRgb{nullptr};
+    pylonImageKernels::yuv422ToRgbFunction m_yuv422ToRgb{nullptr};
+    // Part of the rotation/mirroring the sensor cannot do, nullptr if there is nothing left for the host
+    std::atomic<pylonImageKernels::transformFunction> m_hostTransform{nullptr};
+    std::atomic<pylonImageKernels::transformFunction> m_hostMonoTransform{nullptr};
+    // The host transforms in effect when the frame being processed was retrieved, it is processed with them even if the flips change meanwhile
+    pylonImageKernels::transformFunction m_frameHostTransform{nullptr};
+    pylonImageKernels::transformFunction m_frameHostMonoTransform{nullptr};
+    std::vector<std::uint8_t> m_rotationBuffer;
+    Pylon::CImageFormatConverter m_monoConverter;
+    size_t m_monoConverterPadding{0};
+    std::vector<std::uint8_t> m_monoBuffer;
+#if defined USE_CUDA
+    cv::cuda::GpuMat m_gpuRotationInput;
+    cv::cuda::GpuMat m_gpuRotated;
+#endif  // USE_CUDA
+    // Pipeline health, written by the acquisition side and read at any time by the rpc
+    std::array<pylonLatencyHistogram, stageCount> m_stageLatency;
+    pylonFrameCounters m_frameCounters;
+    std::atomic<std::uint64_t> m_reconnections{0};
+    std::mutex m_failureCodesMutex;
+    std::map<std::uint32_t, std::uint64_t> m_failureCodes;  // pylon error code -> failed grabs
+    pylonLatencyHistogram m_pairSkewHistogram;  // ns, absolute skew of the stereo pairs
+    std::atomic<std::uint64_t> m_statsStartTime{0};  // ns, steady clock
+    std::uint64_t m_lastRetrieveNs{0};
+    std::uint64_t m_rgbLastSequence{0};
+    std::uint64_t m_monoLastSequence{0};
+    std::atomic<size_t> m_bytesCopiedPerFrame{0};
+    std::atomic<std::uint64_t> m_allocations{0};
+
+    // Device removal watchdog
+    std::vector<std::unique_ptr<Pylon::CConfigurationEventHandler>> m_removalHandlers;
+    std::thread m_watchdog;
+    bool m_watchdogRunning{false};  // guarded by m_watchdogMutex
+    bool m_deviceRemoved{false};    // guarded by m_watchdogMutex
+    std::mutex m_watchdogMutex;
+    std::condition_variable m_watchdogWakeUp;
 };
 #endif  // PYLON_DRIVER_H
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#include "pylonClockSync.h"
+
+#include <algorithm>
+
+pylonClockSync::pylonClockSync(double tick_period) : m_tickPeriod(tick_period)
+{
+}
+
+void pylonClockSync::reset()
+{
+    m_bucketValid = false;
+    m_count = 0;
+    m_next = 0;
+    m_drift = 0.0;
+    m_offset = 0.0;
+}
+
+bool pylonClockSync::isValid() const
+{
+    return m_bucketValid;
+}
+
+double pylonClockSync::drift() const
+{
+    return m_drift;
+}
+
+double pylonClockSync::toCameraTime(std::uint64_t ticks) const
+{
+    // Relative to the first sample, a double keeps the ns resolution for months
+    return static_cast<double>(static_cast<std::int64_t>(ticks - m_referenceTicks)) * m_tickPeriod;
+}
+
+void pylonClockSync::addSample(std::uint64_t ticks, double host_time)
+{
+    if (m_bucketValid && ticks <= m_lastTicks)
+    {
+        reset();
+    }
+    if (!m_bucketValid)
+    {
+        m_referenceTicks = ticks;
+    }
+    m_lastTicks = ticks;
+    sample current{toCameraTime(ticks), host_time};
+    // Closed on the time of its first sample, the best one can be the last (e.g. a host clock slower than the camera)
+    if (m_bucketValid && current.cameraTime - m_bucketStart >= bucketPeriod)
+    {
+        m_samples[m_next] = m_bucket;
+        m_next = (m_next + 1) % windowSize;
+        m_count = std::min(m_count + 1, windowSize);
+        m_bucketValid = false;
+    }
+    if (!m_bucketValid)
+    {
+        m_bucketStart = current.cameraTime;
+    }
+    if (!m_bucketValid || current.hostTime - current.cameraTime < m_bucket.hostTime - m_bucket.cameraTime)
+    {
+        m_bucket = current;
+        m_bucketValid = true;
+    }
+    fit();
+}
+
+void pylonClockSync::fit()
+{
+    // host - camera = offset + drift * camera + latency, over the completed buckets
+    if (m_count >= 2)
+    {
+        double mean_x{0.0};
+        double mean_y{0.0};
+        for (size_t i = 0; i < m_count; ++i)
+        {
+            mean_x += m_samples[i].cameraTime;
+            mean_y += m_samples[i].hostTime - m_samples[i].cameraTime;
+        }
+        mean_x /= m_count;
+        mean_y /= m_count;
+        double sxx{0.0};
+        double sxy{0.0};
+        for (size_t i = 0; i < m_count; ++i)
+        {
+            double dx = m_samples[i].cameraTime - mean_x;
+            sxx += dx * dx;
+            sxy += dx * (m_samples[i].hostTime - m_samples[i].cameraTime - mean_y);
+        }
+        m_drift = sxx > 0.0 ? sxy / sxx : 0.0;
+    }
+
+    // The latency is never negative: the sample with the smallest residual is the closest to the true offset
+    m_offset = m_bucket.hostTime - m_bucket.cameraTime * (1.0 + m_drift);
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        m_offset = std::min(m_offset, m_samples[i].hostTime - m_samples[i].cameraTime * (1.0 + m_drift));
+    }
+}
+
+double pylonClockSync::toHostTime(std::uint64_t ticks) const
+{
+    return toCameraTime(ticks) * (1.0 + m_drift) + m_offset;
+}
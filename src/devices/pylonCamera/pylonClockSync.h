@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef PYLON_CLOCK_SYNC_H
+#define PYLON_CLOCK_SYNC_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \brief Online mapping of the camera timestamp counter to the host clock.
+ *
+ * Every sample pairs a camera tick value with the host time in which it was
+ * observed. The host time is the camera one plus an offset, a drift and a
+ * non-negative latency. The samples are grouped in buckets of bucketPeriod
+ * seconds keeping only the one with the smallest latency, the last windowSize
+ * buckets give the drift (least squares slope) over a long baseline and the
+ * offset (lower envelope of the residuals).
+ * It is not thread safe, it is meant to be fed and queried by the acquisition side only.
+ */
+class pylonClockSync
+{
+   public:
+    static constexpr size_t windowSize{128};
+    static constexpr double bucketPeriod{1.0};  // s of camera time
+
+    explicit pylonClockSync(double tick_period = 1e-9);
+
+    // A counter going backwards (e.g. camera reset) restarts the estimation
+    void addSample(std::uint64_t ticks, double host_time);
+    void reset();
+    bool isValid() const;
+    // Host time (s) corresponding to a camera tick value, meaningful only if isValid()
+    double toHostTime(std::uint64_t ticks) const;
+    // Host seconds per camera second minus one
+    double drift() const;
+
+   private:
+    struct sample
+    {
+        double cameraTime;  // s since the first sample
+        double hostTime;
+    };
+
+    double toCameraTime(std::uint64_t ticks) const;
+    void fit();
+
+    double m_tickPeriod;
+    // Best sample of the bucket being filled, then the completed ones
+    sample m_bucket{};
+    bool m_bucketValid{false};
+    double m_bucketStart{0.0};  // camera time of the first sample of the bucket being filled
+    std::array<sample, windowSize> m_samples{};
+    size_t m_count{0};
+    size_t m_next{0};
+    std::uint64_t m_referenceTicks{0};
+    std::uint64_t m_lastTicks{0};
+    double m_drift{0.0};
+    double m_offset{0.0};
+};
+
+#endif  // PYLON_CLOCK_SYNC_H
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef PYLON_FRAME_COUNTERS_H
+#define PYLON_FRAME_COUNTERS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \brief Lock-free counters of the frames, since the last reset and over the last seconds.
+ *
+ * The window is a ring of one second buckets, a bucket is recycled when its
+ * slot comes around again. add() is a relaxed atomic increment and can be
+ * called by any thread while another one reads the counts; what is added by a
+ * concurrent add() while a bucket is recycled may be lost from the window
+ * (never from the totals).
+ */
+class pylonFrameCounters
+{
+   public:
+    enum counter
+    {
+        delivered,   // returned by getImage()
+        dropped,     // acquired but replaced by a newer one before any getImage()
+        skipped,     // received but skipped by the grab strategy
+        lost,        // sent by the camera and never received (e.g. USB/GigE bandwidth)
+        incomplete,  // received with missing data
+        failed,      // any other failed grab
+        counterCount
+    };
+    static constexpr size_t maxWindow{60};  // s
+
+    static std::int64_t nowSeconds() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Length of the window in s, from 1 to maxWindow
+    void setWindow(size_t seconds) noexcept
+    {
+        m_window.store(seconds < 1 ? 1 : (seconds > maxWindow ? maxWindow : seconds), std::memory_order_relaxed);
+    }
+
+    size_t window() const noexcept
+    {
+        return m_window.load(std::memory_order_relaxed);
+    }
+
+    void add(counter c, std::uint64_t count = 1) noexcept
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        m_totals[c].fetch_add(count, std::memory_order_relaxed);
+        auto second = nowSeconds();
+        auto& current = m_buckets[static_cast<size_t>(second) % maxWindow];
+        auto bucket_second = current.second.load(std::memory_order_relaxed);
+        if (bucket_second != second && current.second.compare_exchange_strong(bucket_second, second, std::memory_order_relaxed))
+        {
+            for (auto& bucket_count : current.counts)
+            {
+                bucket_count.store(0, std::memory_order_relaxed);
+            }
+        }
+        current.counts[c].fetch_add(count, std::memory_order_relaxed);
+    }
+
+    // Since the last reset
+    std::uint64_t total(counter c) const noexcept
+    {
+        return m_totals[c].load(std::memory_order_relaxed);
+    }
+
+    // In the current second and the window - 1 previous ones
+    std::uint64_t windowed(counter c) const noexcept
+    {
+        auto now = nowSeconds();
+        auto length = static_cast<std::int64_t>(window());
+        std::uint64_t count{0};
+        for (const auto& bucket : m_buckets)
+        {
+            auto second = bucket.second.load(std::memory_order_relaxed);
+            if (second >= 0 && second <= now && now - second < length)
+            {
+                count += bucket.counts[c].load(std::memory_order_relaxed);
+            }
+        }
+        return count;
+    }
+
+    void reset() noexcept
+    {
+        for (auto& total : m_totals)
+        {
+            total.store(0, std::memory_order_relaxed);
+        }
+        for (auto& bucket : m_buckets)
+        {
+            bucket.second.store(-1, std::memory_order_relaxed);
+            for (auto& bucket_count : bucket.counts)
+            {
+                bucket_count.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+   private:
+    struct bucket
+    {
+        std::atomic<std::int64_t> second{-1};
+        std::array<std::atomic<std::uint64_t>, counterCount> counts{};
+    };
+
+    std::array<std::atomic<std::uint64_t>, counterCount> m_totals{};
+    std::array<bucket, maxWindow> m_buckets{};
+    std::atomic<size_t> m_window{10};
+};
+
+#endif  // PYLON_FRAME_COUNTERS_H
@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#include "pylonFrameRecorder.h"
+
+#include <yarp/os/LogComponent.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#if !defined _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif  // _WIN32
+
+namespace
+{
+YARP_LOG_COMPONENT(PYLON_CAMERA, "yarp.device.pylonCamera")
+
+// Longest wait of the acquisition for the writer to drain the ring before it grows, the frame is dropped after it
+constexpr std::chrono::milliseconds maxDrainWait{5};
+}
+
+pylonFrameRecorder::~pylonFrameRecorder()
+{
+    close();
+}
+
+bool pylonFrameRecorder::open(const std::string& path, size_t slots, size_t max_frame_size, bool direct_io, double tick_period, const std::string& serial_number)
+{
+    close();
+    if (slots == 0)
+    {
+        yCError(PYLON_CAMERA) << "The recording buffer needs at least one frame";
+        return false;
+    }
+#if defined _WIN32
+    yCError(PYLON_CAMERA) << "The recording to" << path << "is not supported on this platform";
+    return false;
+#else
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#if defined O_DIRECT
+    if (direct_io)
+    {
+        m_fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+        if (m_fd < 0 && errno == EINVAL)
+        {
+            yCWarning(PYLON_CAMERA) << "The file system of" << path << "does not support O_DIRECT, recording through the page cache";
+        }
+    }
+#else
+    if (direct_io)
+    {
+        yCWarning(PYLON_CAMERA) << "O_DIRECT is not available, recording through the page cache";
+    }
+#endif  // O_DIRECT
+    if (m_fd < 0)
+    {
+        m_fd = ::open(path.c_str(), flags, 0644);
+    }
+    if (m_fd < 0)
+    {
+        yCError(PYLON_CAMERA) << "Cannot create the recording" << path << "error:" << strerror(errno);
+        return false;
+    }
+
+    // Every slot holds a whole record, aligned as O_DIRECT wants it. The ring is touched now, not by the acquisition
+    m_slotSize = pylonRecording::alignedSize(sizeof(pylonRecording::recordHeader) + max_frame_size);
+    m_slots = slots;
+    void* ring{nullptr};
+    if (posix_memalign(&ring, pylonRecording::alignment, m_slotSize * m_slots) != 0)
+    {
+        yCError(PYLON_CAMERA) << "Cannot allocate" << m_slotSize * m_slots << "bytes for the recording buffer";
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_ring = static_cast<std::uint8_t*>(ring);
+    memset(m_ring, 0, m_slotSize * m_slots);
+    m_recordSizes.assign(m_slots, 0);
+
+    // The file header takes the first page, written from the (still unused) first slot
+    pylonRecording::fileHeader header{};
+    memcpy(header.magic, pylonRecording::fileMagic, sizeof(header.magic));
+    header.version = pylonRecording::version;
+    header.headerSize = pylonRecording::alignment;
+    header.tickPeriod = tick_period;
+    strncpy(header.serialNumber, serial_number.c_str(), sizeof(header.serialNumber) - 1);
+    memcpy(m_ring, &header, sizeof(header));
+    if (!writeAll(m_ring, pylonRecording::alignment))
+    {
+        yCError(PYLON_CAMERA) << "Cannot write the recording" << path << "error:" << strerror(errno);
+        close();
+        return false;
+    }
+    memset(m_ring, 0, pylonRecording::alignment);
+    m_writtenBytes = pylonRecording::alignment;
+#endif  // _WIN32
+
+    m_path = path;
+    m_head = 0;
+    m_tail = 0;
+    m_wantedSlotSize = m_slotSize;
+    m_recordedFrames = 0;
+    m_droppedFrames = 0;
+    m_failed = false;
+    m_running = true;
+    m_writer = std::thread(&pylonFrameRecorder::writeLoop, this);
+    yCInfo(PYLON_CAMERA) << "Recording to" << path << "through a buffer of" << m_slots << "frames of" << m_slotSize << "bytes";
+    return true;
+}
+
+void pylonFrameRecorder::close()
+{
+    if (m_writer.joinable())
+    {
+        m_running = false;
+        m_wakeUp.notify_one();
+        m_writer.join();
+        yCInfo(PYLON_CAMERA) << "Recorded" << m_recordedFrames.load() << "frames to" << m_path << "-" << m_droppedFrames.load() << "frames dropped";
+    }
+#if !defined _WIN32
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+    }
+#endif  // _WIN32
+    m_fd = -1;
+    free(m_ring);
+    m_ring = nullptr;
+    m_recordSizes.clear();
+}
+
+bool pylonFrameRecorder::isOpen() const
+{
+    return m_running;
+}
+
+bool pylonFrameRecorder::push(const pylonFrame& frame, std::uint64_t sequence, double host_time, std::uint32_t sensor_flips)
+{
+    // Every frame that is not recorded is counted, whatever the reason
+    if (!m_running || m_failed)
+    {
+        ++m_droppedFrames;
+        return false;
+    }
+    if (m_wantedSlotSize.load(std::memory_order_relaxed) > m_slotSize && !grow())
+    {
+        ++m_droppedFrames;
+        return false;
+    }
+    auto head = m_head.load(std::memory_order_relaxed);
+    size_t record_size = pylonRecording::alignedSize(sizeof(pylonRecording::recordHeader) + frame.size);
+    if (head - m_tail.load(std::memory_order_acquire) == m_slots || record_size > m_slotSize)
+    {
+        ++m_droppedFrames;
+        return false;
+    }
+
+    pylonRecording::recordHeader header{};
+    header.magic = pylonRecording::recordMagic;
+    header.headerSize = sizeof(header);
+    header.recordSize = record_size;
+    header.sequence = sequence;
+    header.timestamp = frame.timestamp;
+    header.hostTime = host_time;
+    header.width = frame.width;
+    header.height = frame.height;
+    header.pixelType = static_cast<std::uint32_t>(frame.pixelType);
+    header.paddingX = static_cast<std::uint32_t>(frame.paddingX);
+    header.dataSize = frame.size;
+    const auto& metadata = frame.metadata;
+    header.sensorFlips = sensor_flips;
+    header.metadataFlags = (metadata.hasExposureTime ? pylonRecording::hasExposureTime : 0U) | (metadata.hasGain ? pylonRecording::hasGain : 0U) |
+                           (metadata.hasFrameId ? pylonRecording::hasFrameId : 0U) | (metadata.hasTimestamp ? pylonRecording::hasTimestamp : 0U);
+    header.exposureTime = metadata.exposureTime;
+    header.gain = metadata.gain;
+    header.frameId = metadata.frameId;
+    header.chunkTimestamp = metadata.timestamp;
+
+    auto* slot = m_ring + (head % m_slots) * m_slotSize;
+    memcpy(slot, &header, sizeof(header));
+    memcpy(slot + sizeof(header), frame.buffer, frame.size);
+    memset(slot + sizeof(header) + frame.size, 0, record_size - sizeof(header) - frame.size);
+    m_recordSizes[head % m_slots] = record_size;
+    m_head.store(head + 1, std::memory_order_release);
+    m_wakeUp.notify_one();
+    return true;
+}
+
+void pylonFrameRecorder::reserve(size_t max_frame_size)
+{
+    m_wantedSlotSize = pylonRecording::alignedSize(sizeof(pylonRecording::recordHeader) + max_frame_size);
+}
+
+bool pylonFrameRecorder::grow()
+{
+    // The writer only touches the filled slots, with none left the ring can be replaced. Meanwhile the frames are
+    // dropped, the ring drains by itself and a later frame finds it empty
+    {
+        std::unique_lock<std::mutex> lock(m_wakeUpMutex);
+        if (!m_drained.wait_for(lock, maxDrainWait, [this]() { return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_relaxed); }))
+        {
+            return false;
+        }
+    }
+    auto slot_size = m_wantedSlotSize.load(std::memory_order_relaxed);
+#if defined _WIN32
+    return false;
+#else
+    void* ring{nullptr};
+    if (posix_memalign(&ring, pylonRecording::alignment, slot_size * m_slots) != 0)
+    {
+        yCError(PYLON_CAMERA) << "Cannot allocate" << slot_size * m_slots << "bytes for the recording buffer, the frames larger than" << m_slotSize << "bytes are dropped";
+        m_wantedSlotSize = m_slotSize;
+        return true;
+    }
+    memset(ring, 0, slot_size * m_slots);
+    free(m_ring);
+    m_ring = static_cast<std::uint8_t*>(ring);
+    m_slotSize = slot_size;
+#endif  // _WIN32
+    yCInfo(PYLON_CAMERA) << "The recording buffer now holds" << m_slots << "frames of" << m_slotSize << "bytes";
+    return true;
+}
+
+void pylonFrameRecorder::writeLoop()
+{
+    while (true)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire))
+        {
+            // Drained: done if closing, otherwise wait for push(), which does not take the lock
+            if (!m_running)
+            {
+                return;
+            }
+            std::unique_lock<std::mutex> lock(m_wakeUpMutex);
+            m_drained.notify_one();
+            m_wakeUp.wait_for(lock, std::chrono::milliseconds(10), [this, tail]() { return !m_running || m_head.load(std::memory_order_acquire) != tail; });
+            continue;
+        }
+        auto index = tail % m_slots;
+        if (!m_failed && writeAll(m_ring + index * m_slotSize, m_recordSizes[index]))
+        {
+            ++m_recordedFrames;
+            m_writtenBytes += m_recordSizes[index];
+        }
+        else
+        {
+            if (!m_failed)
+            {
+                yCError(PYLON_CAMERA) << "Cannot write the recording" << m_path << "error:" << strerror(errno) << "- recording stopped";
+                m_failed = true;
+            }
+            ++m_droppedFrames;
+        }
+        m_tail.store(tail + 1, std::memory_order_release);
+    }
+}
+
+bool pylonFrameRecorder::writeAll(const std::uint8_t* data, size_t size)
+{
+#if defined _WIN32
+    return false;
+#else
+    while (size > 0)
+    {
+        auto written = ::write(m_fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+#endif  // _WIN32
+}
+
+std::uint64_t pylonFrameRecorder::recordedFrames() const
+{
+    return m_recordedFrames;
+}
+
+std::uint64_t pylonFrameRecorder::droppedFrames() const
+{
+    return m_droppedFrames;
+}
+
+std::uint64_t pylonFrameRecorder::writtenBytes() const
+{
+    return m_writtenBytes;
+}
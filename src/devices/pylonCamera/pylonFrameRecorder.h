@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef PYLON_FRAME_RECORDER_H
+#define PYLON_FRAME_RECORDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pylonFrameSource.h"
+#include "pylonRecording.h"
+
+/**
+ * \brief Lossless recorder of the raw frames (see pylonRecording.h).
+ *
+ * The acquisition thread copies every frame in a slot of a ring preallocated at
+ * open, and never waits: when the ring is full the frame is dropped and
+ * counted. A background thread writes the filled slots, each one already laid
+ * out as an aligned record, so that it can go to the file in a single write,
+ * with O_DIRECT if requested.
+ * There is a single producer, push() must not be called concurrently.
+ */
+class pylonFrameRecorder
+{
+   public:
+    pylonFrameRecorder() = default;
+    ~pylonFrameRecorder();
+    pylonFrameRecorder(const pylonFrameRecorder&) = delete;
+    pylonFrameRecorder& operator=(const pylonFrameRecorder&) = delete;
+
+    // Creates the file and the ring of slots frames of at most max_frame_size bytes
+    bool open(const std::string& path, size_t slots, size_t max_frame_size, bool direct_io, double tick_period, const std::string& serial_number);
+    // Writes the frames still in the ring and closes the file
+    void close();
+    bool isOpen() const;
+    // Copies the frame in the ring with the sensor flips (pylonRecording::sensorFlip bits) applied to it, false if it has been dropped
+    bool push(const pylonFrame& frame, std::uint64_t sequence, double host_time, std::uint32_t sensor_flips);
+    // Asks for slots of frames of max_frame_size bytes (e.g. after a PayloadSize change), push() grows them once
+    // the writer has drained the ring. It does not wait, it can be called by any thread
+    void reserve(size_t max_frame_size);
+
+    std::uint64_t recordedFrames() const;
+    std::uint64_t droppedFrames() const;
+    std::uint64_t writtenBytes() const;
+
+   private:
+    void writeLoop();
+    bool writeAll(const std::uint8_t* data, size_t size);
+    // Replaces the ring with one of m_wantedSlotSize slots, false if the writer has not drained it in time
+    bool grow();
+
+    std::string m_path;
+    int m_fd{-1};
+    std::uint8_t* m_ring{nullptr};
+    size_t m_slotSize{0};
+    size_t m_slots{0};
+    std::vector<size_t> m_recordSizes;
+    // Slots [m_tail, m_head) are filled, m_head is moved by push() and m_tail by the writer
+    std::atomic<size_t> m_head{0};
+    std::atomic<size_t> m_tail{0};
+
+    std::thread m_writer;
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_failed{false};
+    std::mutex m_wakeUpMutex;
+    std::condition_variable m_wakeUp;
+    // Notified by the writer, under m_wakeUpMutex, each time it has drained the ring
+    std::condition_variable m_drained;
+    std::atomic<size_t> m_wantedSlotSize{0};
+
+    std::atomic<std::uint64_t> m_recordedFrames{0};
+    std::atomic<std::uint64_t> m_droppedFrames{0};
+    std::atomic<std::uint64_t> m_writtenBytes{0};
+};
+
+#endif  // PYLON_FRAME_RECORDER_H
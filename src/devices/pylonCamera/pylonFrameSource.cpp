@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#include "pylonFrameSource.h"
+
+#include <yarp/os/LogComponent.h>
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace
+{
+YARP_LOG_COMPONENT(PYLON_CAMERA, "yarp.device.pylonCamera")
+
+// Pylon error codes of the grabs that delivered part of the frame. Any other code counts as a failed grab: an unknown
+// incomplete one is never reported as a success, and it is still listed with its code in the stats
+constexpr std::array<std::uint32_t, 2> incompleteErrorCodes{
+    0xE1000014,  // GigE: the buffer was incompletely grabbed (packets missing)
+    0xE2000212,  // USB: payload data discarded by the camera, e.g. for insufficient bandwidth
+};
+}  // namespace
+
+class pylonCameraSource::imageEventHandler : public Pylon::CImageEventHandler
+{
+   public:
+    explicit imageEventHandler(pylonCameraSource& source) : m_source(source)
+    {
+    }
+
+    void OnImageGrabbed(Pylon::CInstantCamera& /*camera*/, const Pylon::CGrabResultPtr& grab_result) override
+    {
+        m_source.onImageGrabbed(grab_result);
+    }
+
+   private:
+    pylonCameraSource& m_source;
+};
+
+pylonCameraSource::pylonCameraSource(Pylon::CInstantCamera& camera) : m_camera(camera)
+{
+}
+
+pylonCameraSource::~pylonCameraSource()
+{
+    if (m_eventHandler)
+    {
+        // The grab thread of pylon must not call the handler anymore
+        stopGrabbing();
+        m_camera.DeregisterImageEventHandler(m_eventHandler.get());
+    }
+}
+
+void pylonCameraSource::setChunksEnabled(bool enabled)
+{
+    m_chunksEnabled = enabled;
+    m_chunkHandles.clear();
+}
+
+void pylonCameraSource::setGrabSettings(const pylonGrabSettings& settings)
+{
+    m_grabSettings = settings;
+    if (m_grabSettings.strategy == Pylon::GrabStrategy_UpcomingImage && m_camera.GetDeviceInfo().GetDeviceClass() == "BaslerUsb")
+    {
+        // Not supported by the USB transport layer, the closest one is used
+        yCWarning(PYLON_CAMERA) << "Camera" << m_camera.GetDeviceInfo().GetSerialNumber() << "is a USB camera, it cannot grab the upcoming image, grabbing the latest one";
+        m_grabSettings.strategy = Pylon::GrabStrategy_LatestImageOnly;
+    }
+}
+
+void pylonCameraSource::setFrameHandler(pylonFrameHandler handler)
+{
+    m_frameHandler = std::move(handler);
+    if (!m_eventHandler)
+    {
+        m_eventHandler = std::make_unique<imageEventHandler>(*this);
+        m_camera.RegisterImageEventHandler(m_eventHandler.get(), Pylon::RegistrationMode_Append, Pylon::Cleanup_None);
+    }
+}
+
+bool pylonCameraSource::startGrabbing()
+{
+    if (!m_camera.IsGrabbing())
+    {
+        size_t buffers = m_grabSettings.maxNumBuffer;
+        Pylon::CIntegerParameter payload_size(m_camera.GetNodeMap(), "PayloadSize");
+        if (m_grabSettings.memoryBudget > 0 && payload_size.IsReadable() && payload_size.GetValue() > 0)
+        {
+            // At least two buffers, one being filled while the other one is processed
+            buffers = std::max<size_t>(std::min<size_t>(buffers, m_grabSettings.memoryBudget / static_cast<size_t>(payload_size.GetValue())), 2);
+            if (buffers < m_grabSettings.maxNumBuffer)
+            {
+                yCWarning(PYLON_CAMERA) << "Camera" << m_camera.GetDeviceInfo().GetSerialNumber() << "has" << buffers << "buffers instead of" << m_grabSettings.maxNumBuffer
+                                        << "to stay within" << m_grabSettings.memoryBudget / (1024 * 1024) << "MB";
+            }
+        }
+        m_camera.MaxNumBuffer.SetValue(static_cast<int64_t>(buffers));
+        if (m_grabSettings.strategy == Pylon::GrabStrategy_LatestImages)
+        {
+            m_camera.OutputQueueSize.SetValue(static_cast<int64_t>(std::min(m_grabSettings.outputQueueSize, buffers)));
+        }
+        m_buffers = buffers;
+        // Reserved for all the buffers, resolving the chunks of a new one does not allocate
+        m_chunkHandles.clear();
+        m_chunkHandles.reserve(buffers);
+        m_haveLastBlockId = false;
+        m_lastBlockId = 0;
+        m_lastImageNumber = 0;
+        if (m_frameHandler)
+        {
+            // Every frame is pushed as it arrives, nothing is there to request the upcoming one
+            auto strategy = m_grabSettings.strategy == Pylon::GrabStrategy_UpcomingImage ? Pylon::GrabStrategy_LatestImageOnly : m_grabSettings.strategy;
+            m_camera.StartGrabbing(strategy, Pylon::GrabLoop_ProvidedByInstantCamera);
+        }
+        else
+        {
+            m_camera.StartGrabbing(m_grabSettings.strategy);
+        }
+    }
+    return true;
+}
+
+void pylonCameraSource::stopGrabbing()
+{
+    if (m_camera.IsGrabbing())
+    {
+        m_camera.StopGrabbing();
+    }
+}
+
+bool pylonCameraSource::isGrabbing() const
+{
+    return m_camera.IsGrabbing();
+}
+
+double pylonCameraSource::tickPeriod() const
+{
+    // USB cameras count ns, GigE ones declare their frequency
+    Pylon::CIntegerParameter tick_frequency(m_camera.GetNodeMap(), "GevTimestampTickFrequency");
+    if (tick_frequency.IsReadable() && tick_frequency.GetValue() > 0)
+    {
+        return 1.0 / static_cast<double>(tick_frequency.GetValue());
+    }
+    return 1e-9;
+}
+
+bool pylonCameraSource::retrieveFrame(unsigned int timeout_ms, pylonFrame& frame)
+{
+    m_camera.RetrieveResult(timeout_ms, m_grabResult, Pylon::TimeoutHandling_ThrowException);
+    return fillFrame(frame);
+}
+
+void pylonCameraSource::onImageGrabbed(const Pylon::CGrabResultPtr& grab_result)
+{
+    // Kept until the next frame, the handler can use the buffer without copying it
+    m_grabResult = grab_result;
+    pylonFrame frame;
+    bool succeeded = fillFrame(frame);
+    m_frameHandler(succeeded, frame);
+}
+
+bool pylonCameraSource::fillFrame(pylonFrame& frame)
+{
+    if (!m_grabResult)
+    {
+        frame.status = pylonGrabStatus::failed;
+        return false;
+    }
+    countMissingFrames(frame);
+    if (!m_grabResult->GrabSucceeded())
+    {
+        frame.errorCode = m_grabResult->GetErrorCode();
+        bool incomplete = std::find(incompleteErrorCodes.begin(), incompleteErrorCodes.end(), frame.errorCode) != incompleteErrorCodes.end();
+        frame.status = incomplete ? pylonGrabStatus::incomplete : pylonGrabStatus::failed;
+        yCErrorThrottle(PYLON_CAMERA, 1.0) << "Camera" << m_camera.GetDeviceInfo().GetSerialNumber() << (incomplete ? "grabbed an incomplete frame, error" : "failed to grab a frame, error")
+                                           << frame.errorCode << m_grabResult->GetErrorDescription().c_str();
+        return false;
+    }
+    frame.status = pylonGrabStatus::succeeded;
+    frame.errorCode = 0;
+    frame.buffer = static_cast<const std::uint8_t*>(m_grabResult->GetBuffer());
+    frame.size = m_grabResult->GetImageSize();
+    frame.width = m_grabResult->GetWidth();
+    frame.height = m_grabResult->GetHeight();
+    frame.pixelType = m_grabResult->GetPixelType();
+    frame.paddingX = m_grabResult->GetPaddingX();
+    frame.timestamp = m_grabResult->GetTimeStamp();
+    readChunks(frame.metadata);
+    // The buffers still waiting after this one, a growing backlog means the consumer is too slow
+    auto ready = static_cast<size_t>(m_camera.NumReadyBuffers.GetValue());
+    m_readyBuffers = ready;
+    if (ready > m_peakReadyBuffers)
+    {
+        m_peakReadyBuffers = ready;
+    }
+    return true;
+}
+
+void pylonCameraSource::countMissingFrames(pylonFrame& frame)
+{
+    // The image numbers count the frames received by the instant camera, the block IDs the ones sent by the camera:
+    // a gap in the first ones is skipped by the grab strategy, what is left of a gap in the second ones never arrived
+    auto image_number = static_cast<std::uint64_t>(m_grabResult->GetImageNumber());
+    auto block_id = m_grabResult->GetBlockID();
+    frame.skippedFrames = static_cast<std::uint64_t>(m_grabResult->GetNumberOfSkippedImages());
+    if (m_lastImageNumber != 0 && image_number > m_lastImageNumber + 1)
+    {
+        frame.skippedFrames = std::max(frame.skippedFrames, image_number - m_lastImageNumber - 1);
+    }
+    frame.lostFrames = 0;
+    // Not every transport layer has block IDs, and the 16 bit ones of GigE wrap around: a step back only moves the base
+    if (block_id != std::numeric_limits<std::uint64_t>::max())
+    {
+        if (m_haveLastBlockId && block_id > m_lastBlockId + 1 + frame.skippedFrames)
+        {
+            frame.lostFrames = block_id - m_lastBlockId - 1 - frame.skippedFrames;
+        }
+        m_lastBlockId = block_id;
+        m_haveLastBlockId = true;
+    }
+    m_lastImageNumber = image_number;
+}
+
+bool pylonCameraSource::bufferStats(pylonBufferStats& stats)
+{
+    stats.buffers = m_buffers;
+    stats.readyBuffers = m_readyBuffers;
+    stats.peakReadyBuffers = m_peakReadyBuffers;
+    // The stream grabber restarts its statistics when it is reopened
+    auto underruns = readUnderruns();
+    stats.underruns = underruns >= m_underrunsBase ? underruns - m_underrunsBase : underruns;
+    return true;
+}
+
+void pylonCameraSource::resetBufferStats()
+{
+    m_peakReadyBuffers = 0;
+    m_underrunsBase = readUnderruns();
+}
+
+std::uint64_t pylonCameraSource::readUnderruns()
+{
+    // Counted by the stream grabber of both the USB and the GigE transport layers
+    Pylon::CIntegerParameter underruns(m_camera.GetStreamGrabberNodeMap(), "Statistic_Buffer_Underrun_Count");
+    return underruns.IsReadable() ? static_cast<std::uint64_t>(underruns.GetValue()) : 0;
+}
+
+void pylonCameraSource::readChunks(pylonFrameMetadata& metadata)
+{
+    metadata = pylonFrameMetadata();
+    if (!m_chunksEnabled || !m_grabResult->IsChunkDataAvailable())
+    {
+        return;
+    }
+    try
+    {
+        // The chunks travel with the frame, no node of the camera is read
+        auto& handles = resolveChunks(m_grabResult->GetChunkDataNodeMap());
+        if (handles.exposureTime.IsReadable())
+        {
+            metadata.exposureTime = handles.exposureTime.GetValue();
+            metadata.hasExposureTime = true;
+        }
+        if (handles.gain.IsReadable())
+        {
+            metadata.gain = handles.gain.GetValue();
+            metadata.hasGain = true;
+        }
+        if (handles.frameId.IsReadable())
+        {
+            metadata.frameId = handles.frameId.GetValue();
+            metadata.hasFrameId = true;
+        }
+        if (handles.timestamp.IsReadable())
+        {
+            metadata.timestamp = static_cast<std::uint64_t>(handles.timestamp.GetValue());
+            metadata.hasTimestamp = true;
+        }
+    }
+    catch (const Pylon::GenericException& e)
+    {
+        yCErrorThrottle(PYLON_CAMERA, 1.0) << "Cannot read the chunks error:" << e.GetDescription();
+    }
+}
+
+pylonCameraSource::chunkHandles& pylonCameraSource::resolveChunks(GenApi::INodeMap& chunks)
+{
+    auto resolved = std::find_if(m_chunkHandles.begin(), m_chunkHandles.end(), [&chunks](const chunkHandles& handles) { return handles.nodeMap == &chunks; });
+    if (resolved != m_chunkHandles.end())
+    {
+        return *resolved;
+    }
+    if (m_chunkHandles.size() == m_chunkHandles.capacity())
+    {
+        // More node maps than buffers (e.g. before the first start), they are resolved again instead of growing
+        m_chunkHandles.clear();
+    }
+    m_chunkHandles.emplace_back();
+    auto& handles = m_chunkHandles.back();
+    handles.nodeMap = &chunks;
+    handles.exposureTime.Attach(chunks, "ChunkExposureTime");
+    handles.gain.Attach(chunks, "ChunkGain");
+    handles.frameId.Attach(chunks, "ChunkFrameID");
+    handles.timestamp.Attach(chunks, "ChunkTimestamp");
+    return handles;
+}
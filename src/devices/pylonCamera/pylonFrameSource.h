@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef PYLON_FRAME_SOURCE_H
+#define PYLON_FRAME_SOURCE_H
+
+#include <pylon/PylonIncludes.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Camera state in effect for a frame, parsed from the chunks attached to it. A field is valid only if its chunk was received
+struct pylonFrameMetadata
+{
+    bool hasExposureTime{false};
+    double exposureTime{0.0};  // us
+    bool hasGain{false};
+    double gain{0.0};  // dB
+    bool hasFrameId{false};
+    std::int64_t frameId{0};
+    bool hasTimestamp{false};
+    std::uint64_t timestamp{0};  // camera ticks
+};
+
+enum class pylonGrabStatus
+{
+    succeeded,
+    incomplete,  // part of the data has not been received
+    failed
+};
+
+// A frame as delivered by the source, the buffer is owned by the source and valid until the next retrieveFrame()
+struct pylonFrame
+{
+    const std::uint8_t* buffer{nullptr};
+    size_t size{0};
+    std::uint32_t width{0};
+    std::uint32_t height{0};
+    Pylon::EPixelType pixelType{Pylon::PixelType_Undefined};
+    size_t paddingX{0};
+    std::uint64_t timestamp{0};      // camera ticks
+    std::uint64_t skippedFrames{0};  // frames received but skipped by the source before this one
+    std::uint64_t lostFrames{0};     // frames sent by the camera but never received before this one
+    pylonGrabStatus status{pylonGrabStatus::succeeded};
+    std::uint32_t errorCode{0};  // pylon error code of a failed grab
+    pylonFrameMetadata metadata;
+    std::uint32_t sensorFlips{0};  // pylonRecording::sensorFlip bits, known for the replayed frames only
+};
+
+// How the buffers of a camera are allocated and queued, see the acquisition_profile parameter
+struct pylonGrabSettings
+{
+    Pylon::EGrabStrategy strategy{Pylon::GrabStrategy_LatestImageOnly};
+    size_t maxNumBuffer{10};
+    size_t outputQueueSize{1};  // LatestImages only
+    size_t memoryBudget{0};     // bytes, caps maxNumBuffer on the payload size, 0 for no cap
+};
+
+// Occupancy of the buffer pool of a source
+struct pylonBufferStats
+{
+    size_t buffers{0};          // allocated
+    size_t readyBuffers{0};     // filled and waiting to be retrieved
+    size_t peakReadyBuffers{0};
+    std::uint64_t underruns{0};  // frames lost because no buffer was free
+};
+
+// Called by the grab thread of pylon with every frame, succeeded is false for a failed grab
+using pylonFrameHandler = std::function<void(bool succeeded, const pylonFrame& frame)>;
+
+/**
+ * \brief Where the driver takes its frames from.
+ *
+ * The acquisition pipeline (conversion, rotation, handoff to getImage()) only
+ * sees pylonFrame, so it runs the same on a live camera and on a recording.
+ */
+class pylonFrameSource
+{
+   public:
+    virtual ~pylonFrameSource() = default;
+
+    virtual bool startGrabbing() = 0;
+    virtual void stopGrabbing() = 0;
+    virtual bool isGrabbing() const = 0;
+    // Waits for the next frame, false if the frame is not valid. Throws the pylon exceptions (e.g. the timeout)
+    virtual bool retrieveFrame(unsigned int timeout_ms, pylonFrame& frame) = 0;
+    // s per tick of pylonFrame::timestamp
+    virtual double tickPeriod() const = 0;
+    // Buffer pool of the source, false if it has none
+    virtual bool bufferStats(pylonBufferStats& /*stats*/)
+    {
+        return false;
+    }
+    virtual void resetBufferStats()
+    {
+    }
+};
+
+// Frames of a live camera, the grab result of the last frame is kept until the next one is retrieved
+class pylonCameraSource : public pylonFrameSource
+{
+   public:
+    explicit pylonCameraSource(Pylon::CInstantCamera& camera);
+    ~pylonCameraSource() override;
+    pylonCameraSource(const pylonCameraSource&) = delete;
+    pylonCameraSource& operator=(const pylonCameraSource&) = delete;
+
+    // The chunks are read only if they have been enabled on the camera
+    void setChunksEnabled(bool enabled);
+    // Applied at every start of the stream, the buffers depend on the payload size
+    void setGrabSettings(const pylonGrabSettings& settings);
+    // With a handler the frames are pushed by the grab thread of pylon as soon as they arrive, retrieveFrame() is not used
+    void setFrameHandler(pylonFrameHandler handler);
+
+    bool startGrabbing() override;
+    void stopGrabbing() override;
+    bool isGrabbing() const override;
+    bool retrieveFrame(unsigned int timeout_ms, pylonFrame& frame) override;
+    double tickPeriod() const override;
+    bool bufferStats(pylonBufferStats& stats) override;
+    void resetBufferStats() override;
+
+   private:
+    class imageEventHandler;
+
+    // Chunk nodes of a chunk data node map. Pylon attaches one to each buffer and reuses it with the buffer, so the
+    // handles are resolved at the first frame of each buffer and reused by the following ones
+    struct chunkHandles
+    {
+        GenApi::INodeMap* nodeMap{nullptr};
+        Pylon::CFloatParameter exposureTime;
+        Pylon::CFloatParameter gain;
+        Pylon::CIntegerParameter frameId;
+        Pylon::CIntegerParameter timestamp;
+    };
+
+    void onImageGrabbed(const Pylon::CGrabResultPtr& grab_result);
+    // Frame of m_grabResult, false if the grab failed. The counters of the frame are filled in any case
+    bool fillFrame(pylonFrame& frame);
+    void countMissingFrames(pylonFrame& frame);
+    void readChunks(pylonFrameMetadata& metadata);
+    chunkHandles& resolveChunks(GenApi::INodeMap& chunks);
+    std::uint64_t readUnderruns();
+
+    Pylon::CInstantCamera& m_camera;
+    Pylon::CGrabResultPtr m_grabResult;
+    bool m_chunksEnabled{false};
+    // One per buffer, dropped when the chunks are enabled and when the stream restarts with new buffers
+    std::vector<chunkHandles> m_chunkHandles;
+    pylonGrabSettings m_grabSettings;
+    pylonFrameHandler m_frameHandler;
+    std::unique_ptr<Pylon::CImageEventHandler> m_eventHandler;
+    std::atomic<size_t> m_buffers{0};
+    std::atomic<size_t> m_readyBuffers{0};
+    std::atomic<size_t> m_peakReadyBuffers{0};
+    std::uint64_t m_underrunsBase{0};
+    // Of the last grab result. The image numbers start from 1, 0 is before the first one of the stream. The block IDs
+    // of USB3 Vision start from 0, m_haveLastBlockId tells
+    bool m_haveLastBlockId{false};
+    std::uint64_t m_lastBlockId{0};
+    std::uint64_t m_lastImageNumber{0};
+};
+
+#endif  // PYLON_FRAME_SOURCE_H
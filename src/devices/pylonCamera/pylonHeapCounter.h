@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef PYLON_HEAP_COUNTER_H
+#define PYLON_HEAP_COUNTER_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * \brief Heap allocations made by the calling thread.
+ *
+ * They are counted only in the executables built with PYLON_COUNT_ALLOCATIONS,
+ * that replace the global operator new with the counting one of
+ * benchmarks/heapCounter.cpp (e.g. pylonSoakTest). Anywhere else the count is
+ * always zero and the scopes compile to nothing.
+ */
+namespace pylonHeapCounter
+{
+#if defined PYLON_COUNT_ALLOCATIONS
+std::uint64_t threadAllocations() noexcept;
+#else
+inline std::uint64_t threadAllocations() noexcept
+{
+    return 0;
+}
+#endif  // PYLON_COUNT_ALLOCATIONS
+}  // namespace pylonHeapCounter
+
+// Adds the heap allocations made by the calling thread during the scope to a counter
+class pylonAllocationScope
+{
+   public:
+    explicit pylonAllocationScope(std::atomic<std::uint64_t>& counter) noexcept : m_counter(counter), m_start(pylonHeapCounter::threadAllocations())
+    {
+    }
+    ~pylonAllocationScope()
+    {
+        auto allocations = pylonHeapCounter::threadAllocations() - m_start;
+        if (allocations > 0)
+        {
+            m_counter.fetch_add(allocations, std::memory_order_relaxed);
+        }
+    }
+    pylonAllocationScope(const pylonAllocationScope&) = delete;
+    pylonAllocationScope& operator=(const pylonAllocationScope&) = delete;
+
+   private:
+    std::atomic<std::uint64_t>& m_counter;
+    std::uint64_t m_start;
+};
+
+#endif  // PYLON_HEAP_COUNTER_H
@@ -0,0 +1,559 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#include "pylonImageKernels.h"
+
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PYLON_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PYLON_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace pylonImageKernels;
+
+namespace
+{
+// All the kernels, scalar and vector, share the same integer arithmetic, so they produce the same bytes.
+// avg() is the rounding average of _mm_avg_epu8/vrhaddq_u8, the YUV coefficients are in Q6.
+inline std::uint8_t avg(std::uint8_t a, std::uint8_t b)
+{
+    return static_cast<std::uint8_t>((a + b + 1) >> 1);
+}
+
+inline std::uint8_t saturate(int value)
+{
+    return static_cast<std::uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+constexpr int yuv_r_v{90};
+constexpr int yuv_g_u{-22};
+constexpr int yuv_g_v{-46};
+constexpr int yuv_b_u{113};
+
+struct bayerRowLayout
+{
+    bool redRow;     // the row contains red pixels, otherwise blue ones
+    bool colorEven;  // the red/blue pixels are in the even columns
+};
+
+bayerRowLayout rowLayout(bayerPattern pattern, size_t y)
+{
+    bool top_red = pattern == bayerPattern::RG || pattern == bayerPattern::GR;
+    bool top_color_even = pattern == bayerPattern::RG || pattern == bayerPattern::BG;
+    bool odd_row = (y & 1) != 0;
+    return {top_red != odd_row, top_color_even != odd_row};
+}
+
+// Scalar demosaicing of the pixels [x_begin, x_end) of a row, the borders are reflected so the bayer phase is kept
+void bayerRowScalar(const std::uint8_t* up, const std::uint8_t* mid, const std::uint8_t* down, size_t width, size_t x_begin, size_t x_end, bayerRowLayout layout, std::uint8_t* dst)
+{
+    for (size_t x = x_begin; x < x_end; ++x)
+    {
+        size_t xl = x == 0 ? 1 : x - 1;
+        size_t xr = x == width - 1 ? width - 2 : x + 1;
+        std::uint8_t horizontal = avg(mid[xl], mid[xr]);
+        std::uint8_t vertical = avg(up[x], down[x]);
+        std::uint8_t diagonal = avg(avg(up[xl], up[xr]), avg(down[xl], down[xr]));
+        bool is_color = ((x & 1) == 0) == layout.colorEven;
+        std::uint8_t color = is_color ? mid[x] : horizontal;
+        std::uint8_t green = is_color ? avg(horizontal, vertical) : mid[x];
+        std::uint8_t other = is_color ? diagonal : vertical;
+        std::uint8_t* pixel = dst + 3 * x;
+        pixel[0] = layout.redRow ? color : other;
+        pixel[1] = green;
+        pixel[2] = layout.redRow ? other : color;
+    }
+}
+
+using bayerRowFunction = void (*)(const std::uint8_t* up, const std::uint8_t* mid, const std::uint8_t* down, size_t width, bayerRowLayout layout, std::uint8_t* dst);
+
+void bayerRowFullScalar(const std::uint8_t* up, const std::uint8_t* mid, const std::uint8_t* down, size_t width, bayerRowLayout layout, std::uint8_t* dst)
+{
+    bayerRowScalar(up, mid, down, width, 0, width, layout, dst);
+}
+
+template <bayerRowFunction row_kernel>
+void bayerToRgb(const std::uint8_t* src, size_t src_stride, std::uint8_t* dst, size_t dst_stride, size_t width, size_t height, bayerPattern pattern)
+{
+    if (width < 2 || height < 2)
+    {
+        return;
+    }
+    for (size_t y = 0; y < height; ++y)
+    {
+        const std::uint8_t* up = src + (y == 0 ? 1 : y - 1) * src_stride;
+        const std::uint8_t* down = src + (y == height - 1 ? height - 2 : y + 1) * src_stride;
+        row_kernel(up, src + y * src_stride, down, width, rowLayout(pattern, y), dst + y * dst_stride);
+    }
+}
+
+inline void yuvPixelScalar(int y, int u, int v, std::uint8_t* pixel)
+{
+    pixel[0] = saturate(y + ((yuv_r_v * v + 32) >> 6));
+    pixel[1] = saturate(y + ((yuv_g_u * u + yuv_g_v * v + 32) >> 6));
+    pixel[2] = saturate(y + ((yuv_b_u * u + 32) >> 6));
+}
+
+// Converts the pixels [x_begin, width) of a row, x_begin must be even
+void yuv422RowScalar(const std::uint8_t* src, size_t x_begin, size_t width, std::uint8_t* dst)
+{
+    for (size_t x = x_begin; x + 1 < width; x += 2)
+    {
+        const std::uint8_t* pair = src + 2 * x;
+        int u = pair[1] - 128;
+        int v = pair[3] - 128;
+        yuvPixelScalar(pair[0], u, v, dst + 3 * x);
+        yuvPixelScalar(pair[2], u, v, dst + 3 * (x + 1));
+    }
+}
+
+void yuv422ToRgbScalar(const std::uint8_t* src, size_t src_stride, std::uint8_t* dst, size_t dst_stride, size_t width, size_t height)
+{
+    for (size_t y = 0; y < height; ++y)
+    {
+        yuv422RowScalar(src + y * src_stride, 0, width, dst + y * dst_stride);
+    }
+}
+
+// Side of the square tiles walked by the rotations: a tile of the source and of the destination (32 rows of 96 bytes each for RGB) stay in L1
+constexpr size_t rotation_tile{32};
+
+template <size_t pixel_size>
+inline void copyPixel(const std::uint8_t* src, std::uint8_t* dst)
+{
+    for (size_t i = 0; i < pixel_size; ++i)
+    {
+        dst[i] = src[i];
+    }
+}
+
+// Transposes the image, then optionally reverses the order of the destination rows and/or columns
+template <size_t pixel_size, bool reverse_rows, bool reverse_cols>
+void transposePixels(const std::uint8_t* src, size_t src_stride, std::uint8_t* dst, size_t dst_stride, size_t width, size_t height)
+{
+    for (size_t tile_y = 0; tile_y < height; tile_y += rotation_tile)
+    {
+        size_t y_end = std::min(tile_y + rotation_tile, height);
+        for (size_t tile_x = 0; tile_x < width; tile_x += rotation_tile)
+        {
+            size_t x_end = std::min(tile_x + rotation_tile, width);
+            // Each source column of the tile is a destination row: walk it so that the writes are sequential
+            for (size_t x = tile_x; x < x_end; ++x)
+            {
+                std::uint8_t* dst_row = dst + (reverse_rows ? width - 1 - x : x) * dst_stride;
+                const std::uint8_t* src_column = src + pixel_size * x;
+                for (size_t y = tile_y; y < y_end; ++y)
+                {
+                    copyPixel<pixel_size>(src_column + y * src_stride, dst_row + pixel_size * (reverse_cols ? height - 1 - y : y));
+                }
+            }
+        }
+    }
+}
+
+// Reverses the order of the rows and/or columns, the accesses are already sequential so no tiling is needed
+template <size_t pixel_size, bool reverse_rows, bool reverse_cols>
+void flipPixels(const std::uint8_t* src, size_t src_stride, std::uint8_t* dst, size_t dst_stride, size_t width, size_t height)
+{
+    for (size_t y = 0; y < height; ++y)
+    {
+        const std::uint8_t* src_row = src + y * src_stride;
+        std::uint8_t* dst_row = dst + (reverse_rows ? height - 1 - y : y) * dst_stride;
+        for (size_t x = 0; x < width; ++x)
+        {
+            copyPixel<pixel_size>(src_row + pixel_size * x, dst_row + pixel_size * (reverse_cols ? width - 1 - x : x));
+        }
+    }
+}
+
+template <size_t pixel_size>
+transformFunction transformKernel(bool transpose, bool reverse_rows, bool reverse_cols)
+{
+    if (transpose)
+    {
+        if (reverse_rows)
+        {
+            return reverse_cols ? transposePixels<pixel_size, true, true> : transposePixels<pixel_size, true, false>;
+        }
+        return reverse_cols ? transposePixels<pixel_size, false, true> : transposePixels<pixel_size, false, false>;
+    }
+    if (reverse_rows)
+    {
+        return reverse_cols ? flipPixels<pixel_size, true, true> : flipPixels<pixel_size, true, false>;
+    }
+    return reverse_cols ? flipPixels<pixel_size, false, true> : nullptr;
+}
+
+#if defined PYLON_KERNELS_X86
+// pshufb masks that interleave 16 R, G and B bytes into 48 packed RGB bytes
+struct alignas(16) interleaveMasks
+{
+    std::uint8_t mask[3][3][16];  // [output vector][source channel][byte]
+};
+
+constexpr interleaveMasks makeInterleaveMasks()
+{
+    interleaveMasks masks{};
+    for (int out = 0; out < 3; ++out)
+    {
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            for (int byte = 0; byte < 16; ++byte)
+            {
+                int index = 16 * out + byte;
+                masks.mask[out][channel][byte] = index % 3 == channel ? static_cast<std::uint8_t>(index / 3) : 0x80;
+            }
+        }
+    }
+    return masks;
+}
+
+constexpr interleaveMasks interleave_masks = makeInterleaveMasks();
+
+__attribute__((target("ssse3"))) inline void storeRgb(std::uint8_t* dst, __m128i r, __m128i g, __m128i b)
+{
+    for (int out = 0; out < 3; ++out)
+    {
+        const auto* masks = interleave_masks.mask[out];
+        __m128i rgb = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, _mm_load_si128(reinterpret_cast<const __m128i*>(masks[0]))),
+                                                _mm_shuffle_epi8(g, _mm_load_si128(reinterpret_cast<const __m128i*>(masks[1])))),
+                                   _mm_shuffle_epi8(b, _mm_load_si128(reinterpret_cast<const __m128i*>(masks[2]))));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16 * out), rgb);
+    }
+}
+
+__attribute__((target("ssse3"))) inline __m128i load(const std::uint8_t* src)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+__attribute__((target("avx2"))) inline __m256i load256(const std::uint8_t* src)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+}
+
+__attribute__((target("ssse3"))) inline __m128i select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+__attribute__((target("ssse3"))) void bayerRowSsse3(const std::uint8_t* up, const std::uint8_t* mid, const std::uint8_t* down, size_t width, bayerRowLayout layout,
+                                                   std::uint8_t* dst)
+{
+    bayerRowScalar(up, mid, down, width, 0, 1, layout, dst);
+    // The vector loop starts at x = 1, so the even lanes are the odd columns
+    const __m128i even_lanes = _mm_set1_epi16(0x00FF);
+    const __m128i color_mask = layout.colorEven ? _mm_slli_epi16(even_lanes, 8) : even_lanes;
+    size_t x = 1;
+    for (; x + 17 <= width; x += 16)
+    {
+        __m128i center = load(mid + x);
+        __m128i horizontal = _mm_avg_epu8(load(mid + x - 1), load(mid + x + 1));
+        __m128i vertical = _mm_avg_epu8(load(up + x), load(down + x));
+        __m128i diagonal = _mm_avg_epu8(_mm_avg_epu8(load(up + x - 1), load(up + x + 1)), _mm_avg_epu8(load(down + x - 1), load(down + x + 1)));
+        __m128i color = select(color_mask, center, horizontal);
+        __m128i green = select(color_mask, _mm_avg_epu8(horizontal, vertical), center);
+        __m128i other = select(color_mask, diagonal, vertical);
+        if (layout.redRow)
+        {
+            storeRgb(dst + 3 * x, color, green, other);
+        }
+        else
+        {
+            storeRgb(dst + 3 * x, other, green, color);
+        }
+    }
+    bayerRowScalar(up, mid, down, width, x, width, layout, dst);
+}
+
+__attribute__((target("avx2"))) void bayerRowAvx2(const std::uint8_t* up, const std::uint8_t* mid, const std::uint8_t* down, size_t width, bayerRowLayout layout,
+                                                 std::uint8_t* dst)
+{
+    bayerRowScalar(up, mid, down, width, 0, 1, layout, dst);
+    // The vector loop starts at x = 1, so the even lanes are the odd columns
+    const __m256i even_lanes = _mm256_set1_epi16(0x00FF);
+    const __m256i color_mask = layout.colorEven ? _mm256_slli_epi16(even_lanes, 8) : even_lanes;
+    size_t x = 1;
+    for (; x + 33 <= width; x += 32)
+    {
+        __m256i center = load256(mid + x);
+        __m256i horizontal = _mm256_avg_epu8(load256(mid + x - 1), load256(mid + x + 1));
+        __m256i vertical = _mm256_avg_epu8(load256(up + x), load256(down + x));
+        __m256i diagonal = _mm256_avg_epu8(_mm256_avg_epu8(load256(up + x - 1), load256(up + x + 1)), _mm256_avg_epu8(load256(down + x - 1), load256(down + x + 1)));
+        __m256i color = _mm256_blendv_epi8(horizontal, center, color_mask);
+        __m256i green = _mm256_blendv_epi8(center, _mm256_avg_epu8(horizontal, vertical), color_mask);
+        __m256i other = _mm256_blendv_epi8(vertical, diagonal, color_mask);
+        __m256i r = layout.redRow ? color : other;
+        __m256i b = layout.redRow ? other : color;
+        // The interleave shuffles work on 128 bit lanes
+        storeRgb(dst + 3 * x, _mm256_castsi256_si128(r), _mm256_castsi256_si128(green), _mm256_castsi256_si128(b));
+        storeRgb(dst + 3 * (x + 16), _mm256_extracti128_si256(r, 1), _mm256_extracti128_si256(green, 1), _mm256_extracti128_si256(b, 1));
+    }
+    bayerRowScalar(up, mid, down, width, x, width, layout, dst);
+}
+
+// Converts 8 pixels whose Y values are in the low bytes and U/V pairs in the high bytes of each 16 bit lane
+__attribute__((target("ssse3"))) inline void yuvPixelsSsse3(__m128i yuyv, __m128i& r, __m128i& g, __m128i& b)
+{
+    const __m128i offset = _mm_set1_epi16(128);
+    const __m128i rounding = _mm_set1_epi16(32);
+    __m128i y = _mm_and_si128(yuyv, _mm_set1_epi16(0x00FF));
+    __m128i uv = _mm_srli_epi16(yuyv, 8);
+    __m128i u = _mm_sub_epi16(_mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0)), offset);
+    __m128i v = _mm_sub_epi16(_mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1)), offset);
+    r = _mm_add_epi16(y, _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(v, _mm_set1_epi16(yuv_r_v)), rounding), 6));
+    g = _mm_add_epi16(y, _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(u, _mm_set1_epi16(yuv_g_u)), _mm_mullo_epi16(v, _mm_set1_epi16(yuv_g_v))), rounding), 6));
+    b = _mm_add_epi16(y, _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(u, _mm_set1_epi16(yuv_b_u)), rounding), 6));
+}
+
+__attribute__((target("ssse3"))) void yuv422ToRgbSsse3(const std::uint8_t* src, size_t src_stride, std::uint8_t* dst, size_t dst_stride, size_t width, size_t height)
+{
+    for (size_t y = 0; y < height; ++y)
+    {
+        const std::uint8_t* src_row = src + y * src_stride;
+        std::uint8_t* dst_row = dst + y * dst_stride;
+        size_t x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i r_low, g_low, b_low, r_high, g_high, b_high;
+            yuvPixelsSsse3(load(src_row + 2 * x), r_low, g_low, b_low);
+            yuvPixelsSsse3(load(src_row + 2 * x + 16), r_high, g_high, b_high);
+            storeRgb(dst_row + 3 * x, _mm_packus_epi16(r_low, r_high), _mm_packus_epi16(g_low, g_high), _mm_packus_epi16(b_low, b_high));
+        }
+        yuv422RowScalar(src_row, x, width, dst_row);
+    }
+}
+
+bool cpuSupports(simdLevel level)
+{
+    switch (level)
+    {
+        case simdLevel::ssse3:
+            return __builtin_cpu_supports("ssse3");
+        case simdLevel::avx2:
+            return __builtin_cpu_supports("avx2");
+        default:
+            return false;
+    }
+}
+#endif  // PYLON_KERNELS_X86
+
+#if defined PYLON_KERNELS_NEON
+void bayerRowNeon(const std::uint8_t* up, const std::uint8_t* mid, const std::uint8_t* down, size_t width, bayerRowLayout layout, std::uint8_t* dst)
+{
+    bayerRowScalar(up, mid, down, width, 0, 1, layout, dst);
+    // The vector loop starts at x = 1, so the even lanes are the odd columns
+    const uint8x16_t color_mask = vreinterpretq_u8_u16(vdupq_n_u16(layout.colorEven ? 0xFF00 : 0x00FF));
+    size_t x = 1;
+    for (; x + 17 <= width; x += 16)
+    {
+        uint8x16_t center = vld1q_u8(mid + x);
+        uint8x16_t horizontal = vrhaddq_u8(vld1q_u8(mid + x - 1), vld1q_u8(mid + x + 1));
+        uint8x16_t vertical = vrhaddq_u8(vld1q_u8(up + x), vld1q_u8(down + x));
+        uint8x16_t diagonal = vrhaddq_u8(vrhaddq_u8(vld1q_u8(up + x - 1), vld1q_u8(up + x + 1)), vrhaddq_u8(vld1q_u8(down + x - 1), vld1q_u8(down + x + 1)));
+        uint8x16_t color = vbslq_u8(color_mask, center, horizontal);
+        uint8x16_t other = vbslq_u8(color_mask, diagonal, vertical);
+        uint8x16x3_t rgb;
+        rgb.val[0] = layout.redRow ? color : other;
+        rgb.val[1] = vbslq_u8(color_mask, vrhaddq_u8(horizontal, vertical), center);
+        rgb.val[2] = layout.redRow ? other : color;
+        vst3q_u8(dst + 3 * x, rgb);
+    }
+    bayerRowScalar(up, mid, down, width, x, width, layout, dst);
+}
+
+// Converts 8 Y/U/V pairs (16 pixels) into 16 R, G and B values
+inline void yuvPixelsNeon(uint8x8_t y_even, uint8x8_t u8, uint8x8_t y_odd, uint8x8_t v8, uint8x16x3_t& rgb)
+{
+    int16x8_t u = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u8)), vdupq_n_s16(128));
+    int16x8_t v = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v8)), vdupq_n_s16(128));
+    int16x8_t even = vreinterpretq_s16_u16(vmovl_u8(y_even));
+    int16x8_t odd = vreinterpretq_s16_u16(vmovl_u8(y_odd));
+    // vrshrq_n_s16(x, 6) is (x + 32) >> 6
+    int16x8_t r = vrshrq_n_s16(vmulq_n_s16(v, yuv_r_v), 6);
+    int16x8_t g = vrshrq_n_s16(vmlaq_n_s16(vmulq_n_s16(u, yuv_g_u), v, yuv_g_v), 6);
+    int16x8_t b = vrshrq_n_s16(vmulq_n_s16(u, yuv_b_u), 6);
+    uint8x8x2_t r_zip = vzip_u8(vqmovun_s16(vaddq_s16(even, r)), vqmovun_s16(vaddq_s16(odd, r)));
+    uint8x8x2_t g_zip = vzip_u8(vqmovun_s16(vaddq_s16(even, g)), vqmovun_s16(vaddq_s16(odd, g)));
+    uint8x8x2_t b_zip = vzip_u8(vqmovun_s16(vaddq_s16(even, b)), vqmovun_s16(vaddq_s16(odd, b)));
+    rgb.val[0] = vcombine_u8(r_zip.val[0], r_zip.val[1]);
+    rgb.val[1] = vcombine_u8(g_zip.val[0], g_zip.val[1]);
+    rgb.val[2] = vcombine_u8(b_zip.val[0], b_zip.val[1]);
+}
+
+void yuv422ToRgbNeon(const std::uint8_t* src, size_t src_stride, std::uint8_t* dst, size_t dst_stride, size_t width, size_t height)
+{
+    for (size_t y = 0; y < height; ++y)
+    {
+        const std::uint8_t* src_row = src + y * src_stride;
+        std::uint8_t* dst_row = dst + y * dst_stride;
+        size_t x = 0;
+        for (; x + 32 <= width; x += 32)
+        {
+            // Y0 U Y1 V deinterleaved: Y of the even pixels, U, Y of the odd pixels, V
+            uint8x16x4_t yuyv = vld4q_u8(src_row + 2 * x);
+            uint8x16x3_t rgb;
+            yuvPixelsNeon(vget_low_u8(yuyv.val[0]), vget_low_u8(yuyv.val[1]), vget_low_u8(yuyv.val[2]), vget_low_u8(yuyv.val[3]), rgb);
+            vst3q_u8(dst_row + 3 * x, rgb);
+            yuvPixelsNeon(vget_high_u8(yuyv.val[0]), vget_high_u8(yuyv.val[1]), vget_high_u8(yuyv.val[2]), vget_high_u8(yuyv.val[3]), rgb);
+            vst3q_u8(dst_row + 3 * (x + 16), rgb);
+        }
+        yuv422RowScalar(src_row, x, width, dst_row);
+    }
+}
+#endif  // PYLON_KERNELS_NEON
+}  // namespace
+
+simdLevel pylonImageKernels::bestSimdLevel()
+{
+#if defined PYLON_KERNELS_NEON
+    return simdLevel::neon;
+#elif defined PYLON_KERNELS_X86
+    if (cpuSupports(simdLevel::avx2))
+    {
+        return simdLevel::avx2;
+    }
+    if (cpuSupports(simdLevel::ssse3))
+    {
+        return simdLevel::ssse3;
+    }
+    return simdLevel::none;
+#else
+    return simdLevel::none;
+#endif
+}
+
+const char* pylonImageKernels::simdLevelName(simdLevel level)
+{
+    switch (level)
+    {
+        case simdLevel::ssse3:
+            return "SSSE3";
+        case simdLevel::avx2:
+            return "AVX2";
+        case simdLevel::neon:
+            return "NEON";
+        default:
+            return "none";
+    }
+}
+
+bayerToRgbFunction pylonImageKernels::bayerToRgbKernel(simdLevel level)
+{
+    switch (level)
+    {
+        case simdLevel::none:
+            return bayerToRgb<bayerRowFullScalar>;
+#if defined PYLON_KERNELS_X86
+        case simdLevel::ssse3:
+            return cpuSupports(level) ? bayerToRgb<bayerRowSsse3> : nullptr;
+        case simdLevel::avx2:
+            return cpuSupports(level) ? bayerToRgb<bayerRowAvx2> : nullptr;
+#endif
+#if defined PYLON_KERNELS_NEON
+        case simdLevel::neon:
+            return bayerToRgb<bayerRowNeon>;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+yuv422ToRgbFunction pylonImageKernels::yuv422ToRgbKernel(simdLevel level)
+{
+    switch (level)
+    {
+        case simdLevel::none:
+            return yuv422ToRgbScalar;
+#if defined PYLON_KERNELS_X86
+        // The YUV kernel gains nothing from the wider registers, AVX2 CPUs use the SSSE3 one
+        case simdLevel::ssse3:
+        case simdLevel::avx2:
+            return cpuSupports(level) ? yuv422ToRgbSsse3 : nullptr;
+#endif
+#if defined PYLON_KERNELS_NEON
+        case simdLevel::neon:
+            return yuv422ToRgbNeon;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+transformFunction pylonImageKernels::rotateRgbKernel(rotation rot)
+{
+    switch (rot)
+    {
+        case rotation::clockwise90:
+            return transformRgbKernel(true, false, true);
+        case rotation::counterClockwise90:
+            return transformRgbKernel(true, true, false);
+        case rotation::rotate180:
+            return transformRgbKernel(false, true, true);
+        default:
+            return nullptr;
+    }
+}
+
+transformFunction pylonImageKernels::transformRgbKernel(bool transpose, bool reverse_rows, bool reverse_cols)
+{
+    return transformKernel<3>(transpose, reverse_rows, reverse_cols);
+}
+
+transformFunction pylonImageKernels::transformMonoKernel(bool transpose, bool reverse_rows, bool reverse_cols)
+{
+    return transformKernel<1>(transpose, reverse_rows, reverse_cols);
+}
+
+bool pylonImageKernels::rotationOrientation(double degrees, bool mirror, orientation& result)
+{
+    if (degrees == 0.0)
+    {
+        result = {false, false, false};
+    }
+    else if (degrees == 90.0)
+    {
+        result = {true, false, true};
+    }
+    else if (degrees == -90.0)
+    {
+        result = {true, true, false};
+    }
+    else if (degrees == 180.0)
+    {
+        result = {false, true, true};
+    }
+    else
+    {
+        return false;
+    }
+    // Mirroring reverses the output columns, with and without transpose
+    result.reverseCols = result.reverseCols != mirror;
+    return true;
+}
+
+void pylonImageKernels::sensorFlips(const orientation& wanted, bool& reverse_x, bool& reverse_y)
+{
+    reverse_x = wanted.transpose ? wanted.reverseRows : wanted.reverseCols;
+    reverse_y = wanted.transpose ? wanted.reverseCols : wanted.reverseRows;
+}
+
+pylonImageKernels::orientation pylonImageKernels::hostOrientation(const orientation& wanted, bool reverse_x, bool reverse_y)
+{
+    // The flips of the sensor are undone on the destination, their axes are swapped by the transpose
+    orientation host{wanted};
+    host.reverseCols = host.reverseCols != (wanted.transpose ? reverse_y : reverse_x);
+    host.reverseRows = host.reverseRows != (wanted.transpose ? reverse_x : reverse_y);
+    return host;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef PYLON_IMAGE_KERNELS_H
+#define PYLON_IMAGE_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \brief Host side image kernels used by the pylonCamera acquisition pipeline.
+ *
+ * They work on plain buffers (no pylon nor YARP types), every kernel writes its
+ * RGB output directly into the destination in a single pass. Strides are in bytes.
+ */
+namespace pylonImageKernels
+{
+enum class simdLevel
+{
+    none,
+    ssse3,
+    avx2,
+    neon
+};
+
+// Color of the first two pixels of the first row
+enum class bayerPattern
+{
+    RG,
+    GR,
+    GB,
+    BG
+};
+
+enum class rotation
+{
+    clockwise90,
+    counterClockwise90,
+    rotate180
+};
+
+// Output orientation of the transform kernels: optional transpose, then reversal of the destination rows and/or columns
+struct orientation
+{
+    bool transpose{false};
+    bool reverseRows{false};
+    bool reverseCols{false};
+};
+
+// Bilinear demosaicing of an 8 bit bayer image into packed RGB, width and height must be at least 2
+using bayerToRgbFunction = void (*)(const std::uint8_t* src, size_t src_stride, std::uint8_t* dst, size_t dst_stride, size_t width, size_t height, bayerPattern pattern);
+// YUV 4:2:2 (Y0 U Y1 V, full range BT.601) into packed RGB, width must be even
+using yuv422ToRgbFunction = void (*)(const std::uint8_t* src, size_t src_stride, std::uint8_t* dst, size_t dst_stride, size_t width, size_t height);
+// Cache-blocked rotation/flip of a packed image, width and height are the ones of the source
+using transformFunction = void (*)(const std::uint8_t* src, size_t src_stride, std::uint8_t* dst, size_t dst_stride, size_t width, size_t height);
+
+// Best instruction set supported by this build and by the running CPU
+simdLevel bestSimdLevel();
+const char* simdLevelName(simdLevel level);
+
+// Kernels for a given instruction set, nullptr if it is not available
+bayerToRgbFunction bayerToRgbKernel(simdLevel level);
+yuv422ToRgbFunction yuv422ToRgbKernel(simdLevel level);
+transformFunction rotateRgbKernel(rotation rot);
+// Any of the 8 rotations/flips: optional transpose, then reversal of the destination rows and/or columns. nullptr for the identity
+transformFunction transformRgbKernel(bool transpose, bool reverse_rows, bool reverse_cols);
+transformFunction transformMonoKernel(bool transpose, bool reverse_rows, bool reverse_cols);
+
+// Orientation of a rotation (0, 90, -90, 180 degrees) followed by an optional mirroring, false if the rotation is not supported
+bool rotationOrientation(double degrees, bool mirror, orientation& result);
+// Any orientation is a flip of the sensor readout followed by the optional transpose: the flip that the sensor has to do
+void sensorFlips(const orientation& wanted, bool& reverse_x, bool& reverse_y);
+// What is left to the host of the wanted orientation once the sensor has flipped its readout by reverse_x and reverse_y
+orientation hostOrientation(const orientation& wanted, bool reverse_x, bool reverse_y);
+}  // namespace pylonImageKernels
+
+#endif  // PYLON_IMAGE_KERNELS_H
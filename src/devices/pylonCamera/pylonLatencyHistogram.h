@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef PYLON_LATENCY_HISTOGRAM_H
+#define PYLON_LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * \brief Lock-free log-linear (HDR-style) histogram of durations in ns.
+ *
+ * Every power of two is split in 2^subBucketBits linear buckets, so the
+ * percentiles have a relative error below 1/2^subBucketBits at any scale.
+ * record() is a relaxed atomic increment (plus a compare-exchange for a new
+ * maximum), it can be called by any thread while another one reads the percentiles.
+ */
+class pylonLatencyHistogram
+{
+   public:
+    static constexpr unsigned subBucketBits{4};
+    static constexpr unsigned magnitudes{40};  // up to 2^40 ns, ~18 minutes
+
+    static std::uint64_t now() noexcept
+    {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    void record(std::uint64_t value) noexcept
+    {
+        m_buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        auto max = m_max.load(std::memory_order_relaxed);
+        while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    std::uint64_t count() const noexcept
+    {
+        std::uint64_t total{0};
+        for (const auto& bucket : m_buckets)
+        {
+            total += bucket.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    std::uint64_t max() const noexcept
+    {
+        return m_max.load(std::memory_order_relaxed);
+    }
+
+    // Upper bound of the bucket holding the requested percentile (0-100), 0 if empty
+    std::uint64_t percentile(double p) const noexcept
+    {
+        auto total = count();
+        if (total == 0)
+        {
+            return 0;
+        }
+        auto rank = static_cast<std::uint64_t>(p / 100.0 * static_cast<double>(total - 1)) + 1;
+        std::uint64_t seen{0};
+        for (size_t i = 0; i < m_buckets.size(); ++i)
+        {
+            seen += m_buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank)
+            {
+                auto upper = bucketUpperBound(i);
+                return upper < max() ? upper : max();
+            }
+        }
+        return max();
+    }
+
+    void reset() noexcept
+    {
+        for (auto& bucket : m_buckets)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+   private:
+    static constexpr std::uint64_t subBuckets{1ULL << subBucketBits};
+
+    static size_t bucketIndex(std::uint64_t value) noexcept
+    {
+        if (value < subBuckets)
+        {
+            return static_cast<size_t>(value);
+        }
+        unsigned msb = 63U - static_cast<unsigned>(__builtin_clzll(value));
+        if (msb >= subBucketBits + magnitudes)
+        {
+            return (static_cast<size_t>(magnitudes) + 1) * subBuckets - 1;
+        }
+        unsigned shift = msb - subBucketBits;
+        return static_cast<size_t>((shift + 1) * subBuckets + ((value >> shift) - subBuckets));
+    }
+
+    static std::uint64_t bucketUpperBound(size_t index) noexcept
+    {
+        std::uint64_t group = index >> subBucketBits;
+        std::uint64_t sub = index & (subBuckets - 1);
+        if (group == 0)
+        {
+            return sub;
+        }
+        return ((subBuckets + sub + 1) << (group - 1)) - 1;
+    }
+
+    std::array<std::atomic<std::uint64_t>, (magnitudes + 1) * subBuckets> m_buckets{};
+    std::atomic<std::uint64_t> m_max{0};
+};
+
+// Records the lifetime of the scope in a histogram
+class pylonStageTimer
+{
+   public:
+    explicit pylonStageTimer(pylonLatencyHistogram& histogram) noexcept : m_histogram(histogram), m_start(pylonLatencyHistogram::now())
+    {
+    }
+    ~pylonStageTimer()
+    {
+        m_histogram.record(pylonLatencyHistogram::now() - m_start);
+    }
+    pylonStageTimer(const pylonStageTimer&) = delete;
+    pylonStageTimer& operator=(const pylonStageTimer&) = delete;
+
+   private:
+    pylonLatencyHistogram& m_histogram;
+    std::uint64_t m_start;
+};
+
+#endif  // PYLON_LATENCY_HISTOGRAM_H
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef PYLON_RECORDING_H
+#define PYLON_RECORDING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * \brief Layout of the raw frame recordings.
+ *
+ * A recording is a fileHeader followed by one record per frame. A record is a
+ * recordHeader followed by the frame buffer exactly as the camera sent it
+ * (row padding included). The file header and every record are padded to a
+ * multiple of alignment bytes, so that the records can be written with O_DIRECT
+ * and each one starts on a page of the memory mapped file. The records can be
+ * walked (and indexed) through their recordSize. Fields are in host byte order.
+ */
+namespace pylonRecording
+{
+constexpr size_t alignment{4096};
+constexpr char fileMagic[8]{'P', 'Y', 'L', 'N', 'R', 'E', 'C', '\0'};
+constexpr std::uint32_t version{1};
+constexpr std::uint32_t recordMagic{0x44524352};  // "RCRD"
+
+// Bits of recordHeader::metadataFlags, one per valid chunk field
+enum metadataFlag : std::uint32_t
+{
+    hasExposureTime = 1U << 0,
+    hasGain = 1U << 1,
+    hasFrameId = 1U << 2,
+    hasTimestamp = 1U << 3
+};
+
+// Bits of recordHeader::sensorFlips, the readout flips the camera applied to the frame
+enum sensorFlip : std::uint32_t
+{
+    reverseX = 1U << 0,
+    reverseY = 1U << 1
+};
+
+struct fileHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t headerSize;  // bytes before the first record
+    double tickPeriod;         // s per tick of the camera timestamps
+    char serialNumber[64];
+};
+
+struct recordHeader
+{
+    std::uint32_t magic;
+    std::uint32_t headerSize;  // bytes before the frame data
+    std::uint64_t recordSize;  // header, data and padding: the next record starts recordSize bytes after this one
+    std::uint64_t sequence;    // frame number in the acquisition, the gaps are the frames not recorded
+    std::uint64_t timestamp;   // camera ticks
+    double hostTime;           // s, when the frame was retrieved
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t pixelType;  // Pylon::EPixelType
+    std::uint32_t paddingX;
+    std::uint64_t dataSize;
+    std::uint32_t metadataFlags;
+    std::uint32_t sensorFlips;  // the host does only what they leave of the orientation
+    double exposureTime;  // us
+    double gain;          // dB
+    std::int64_t frameId;
+    std::uint64_t chunkTimestamp;
+};
+
+static_assert(std::is_trivially_copyable<fileHeader>::value && std::is_trivially_copyable<recordHeader>::value, "the headers are written as they are");
+
+constexpr size_t alignedSize(size_t size)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+}  // namespace pylonRecording
+
+#endif  // PYLON_RECORDING_H
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#include "pylonReplaySource.h"
+
+#include <yarp/os/LogComponent.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#if !defined _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // _WIN32
+
+namespace
+{
+YARP_LOG_COMPONENT(PYLON_CAMERA, "yarp.device.pylonCamera")
+
+// Larger than the side of any sensor, a bigger one comes from a corrupted record
+constexpr std::uint32_t maxImageSide{65536};
+
+// The image described by the record fits in its data
+bool isValidImage(const pylonRecording::recordHeader& record)
+{
+    auto pixel_type = static_cast<Pylon::EPixelType>(record.pixelType);
+    if (record.width == 0 || record.height == 0 || record.width > maxImageSide || record.height > maxImageSide || pixel_type == Pylon::PixelType_Undefined)
+    {
+        return false;
+    }
+    std::uint64_t bits = Pylon::BitPerPixel(pixel_type);
+    if (bits == 0)
+    {
+        return false;
+    }
+    std::uint64_t row_size = (record.width * bits + 7) / 8 + record.paddingX;
+    return row_size * record.height <= record.dataSize;
+}
+
+std::chrono::steady_clock::duration toDuration(double seconds)
+{
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
+}  // namespace
+
+pylonReplaySource::~pylonReplaySource()
+{
+    close();
+}
+
+bool pylonReplaySource::open(const std::string& path, bool loop)
+{
+    close();
+#if defined _WIN32
+    yCError(PYLON_CAMERA) << "The replay of" << path << "is not supported on this platform";
+    return false;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        yCError(PYLON_CAMERA) << "Cannot open the recording" << path << "error:" << strerror(errno);
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(pylonRecording::fileHeader))
+    {
+        yCError(PYLON_CAMERA) << path << "is not a recording";
+        ::close(fd);
+        return false;
+    }
+    m_size = static_cast<size_t>(file_stat.st_size);
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        yCError(PYLON_CAMERA) << "Cannot map the recording" << path << "error:" << strerror(errno);
+        m_size = 0;
+        return false;
+    }
+    madvise(data, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const std::uint8_t*>(data);
+#endif  // _WIN32
+
+    const auto* header = reinterpret_cast<const pylonRecording::fileHeader*>(m_data);
+    if (memcmp(header->magic, pylonRecording::fileMagic, sizeof(header->magic)) != 0 || header->version != pylonRecording::version ||
+        header->headerSize < sizeof(pylonRecording::fileHeader) || header->headerSize > m_size)
+    {
+        yCError(PYLON_CAMERA) << path << "is not a recording of version" << pylonRecording::version;
+        close();
+        return false;
+    }
+    m_tickPeriod = header->tickPeriod > 0.0 ? header->tickPeriod : 1e-9;
+
+    // The records are walked once, a crash while recording leaves a truncated (or zeroed) tail. Every size is checked
+    // against what is left of the file before it is used, and the image against the data of its record: a corrupted
+    // one stops the walk instead of overflowing it
+    size_t offset = header->headerSize;
+    while (sizeof(pylonRecording::recordHeader) <= m_size - offset)
+    {
+        const auto* current = reinterpret_cast<const pylonRecording::recordHeader*>(m_data + offset);
+        size_t left = m_size - offset;
+        if (current->magic != pylonRecording::recordMagic || current->headerSize < sizeof(pylonRecording::recordHeader) || current->headerSize > left ||
+            current->recordSize > left || current->dataSize > left - current->headerSize || current->recordSize < current->headerSize + current->dataSize ||
+            !isValidImage(*current))
+        {
+            break;
+        }
+        m_records.push_back(offset);
+        offset += current->recordSize;
+    }
+    if (m_records.empty())
+    {
+        yCError(PYLON_CAMERA) << "The recording" << path << "has no frames";
+        close();
+        return false;
+    }
+    if (offset < m_size)
+    {
+        yCWarning(PYLON_CAMERA) << "The recording" << path << "is truncated after" << m_records.size() << "frames";
+    }
+    m_loop = loop;
+    m_next = 0;
+    m_timestampOffset = 0;
+    return true;
+}
+
+void pylonReplaySource::close()
+{
+    stopGrabbing();
+#if !defined _WIN32
+    if (m_data != nullptr)
+    {
+        munmap(const_cast<std::uint8_t*>(m_data), m_size);
+    }
+#endif  // _WIN32
+    m_data = nullptr;
+    m_size = 0;
+    m_records.clear();
+}
+
+size_t pylonReplaySource::frameCount() const
+{
+    return m_records.size();
+}
+
+const pylonRecording::recordHeader& pylonReplaySource::record(size_t index) const
+{
+    return *reinterpret_cast<const pylonRecording::recordHeader*>(m_data + m_records[index]);
+}
+
+const pylonRecording::recordHeader& pylonReplaySource::firstRecord() const
+{
+    return record(0);
+}
+
+double pylonReplaySource::tickPeriod() const
+{
+    return m_tickPeriod;
+}
+
+bool pylonReplaySource::startGrabbing()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (!m_grabbing && !m_records.empty())
+    {
+        // Resumed from where it was stopped
+        m_grabbing = true;
+        m_playbackStart = std::chrono::steady_clock::now();
+        m_playbackBase = m_next < m_records.size() ? record(m_next).hostTime : 0.0;
+    }
+    return m_grabbing;
+}
+
+void pylonReplaySource::stopGrabbing()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_grabbing = false;
+    }
+    m_stopped.notify_all();
+}
+
+bool pylonReplaySource::isGrabbing() const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_grabbing;
+}
+
+bool pylonReplaySource::retrieveFrame(unsigned int timeout_ms, pylonFrame& frame)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_grabbing)
+    {
+        return false;
+    }
+    if (m_next == m_records.size())
+    {
+        if (!m_loop)
+        {
+            yCInfo(PYLON_CAMERA) << "End of the recording after" << m_records.size() << "frames";
+            m_grabbing = false;
+            return false;
+        }
+        // The next loop starts one (average) frame period after the last frame
+        const auto& first = record(0);
+        const auto& last = record(m_records.size() - 1);
+        auto frames = static_cast<std::uint64_t>(std::max<size_t>(m_records.size() - 1, 1));
+        m_timestampOffset += last.timestamp - first.timestamp + (last.timestamp - first.timestamp) / frames;
+        m_playbackStart = std::chrono::steady_clock::now() + toDuration((last.hostTime - first.hostTime) / static_cast<double>(frames));
+        m_playbackBase = first.hostTime;
+        m_next = 0;
+    }
+
+    const auto& current = record(m_next);
+    auto due = m_playbackStart + toDuration(current.hostTime - m_playbackBase);
+    auto limit = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    if (due > limit)
+    {
+        m_playbackStart -= due - limit;
+        due = limit;
+    }
+    if (m_stopped.wait_until(lock, due, [this]() { return !m_grabbing; }))
+    {
+        return false;
+    }
+
+    frame.buffer = m_data + m_records[m_next] + current.headerSize;
+    frame.size = current.dataSize;
+    frame.width = current.width;
+    frame.height = current.height;
+    frame.pixelType = static_cast<Pylon::EPixelType>(current.pixelType);
+    frame.paddingX = current.paddingX;
+    frame.sensorFlips = current.sensorFlips;
+    frame.timestamp = current.timestamp + m_timestampOffset;
+    // The frames dropped while recording are reported as skipped
+    frame.skippedFrames = 0;
+    if (m_next > 0 && current.sequence > record(m_next - 1).sequence + 1)
+    {
+        frame.skippedFrames = current.sequence - record(m_next - 1).sequence - 1;
+    }
+    frame.lostFrames = 0;
+    frame.status = pylonGrabStatus::succeeded;
+    frame.errorCode = 0;
+    frame.metadata = pylonFrameMetadata();
+    frame.metadata.hasExposureTime = (current.metadataFlags & pylonRecording::hasExposureTime) != 0;
+    frame.metadata.exposureTime = current.exposureTime;
+    frame.metadata.hasGain = (current.metadataFlags & pylonRecording::hasGain) != 0;
+    frame.metadata.gain = current.gain;
+    frame.metadata.hasFrameId = (current.metadataFlags & pylonRecording::hasFrameId) != 0;
+    frame.metadata.frameId = current.frameId;
+    frame.metadata.hasTimestamp = (current.metadataFlags & pylonRecording::hasTimestamp) != 0;
+    frame.metadata.timestamp = current.chunkTimestamp + m_timestampOffset;
+    ++m_next;
+    return true;
+}
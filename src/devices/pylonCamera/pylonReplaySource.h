@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef PYLON_REPLAY_SOURCE_H
+#define PYLON_REPLAY_SOURCE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "pylonFrameSource.h"
+#include "pylonRecording.h"
+
+/**
+ * \brief Frames of a recording (see pylonRecording.h), replayed with their original pacing.
+ *
+ * The file is memory mapped, the frames are handed to the pipeline straight
+ * from the mapping without any copy. A frame is returned when as much time as
+ * in the recording has passed since the previous one, gaps longer than the
+ * retrieve timeout are shortened to it. With loop the replay restarts from the
+ * first frame, the timestamps keep increasing across the loops.
+ */
+class pylonReplaySource : public pylonFrameSource
+{
+   public:
+    pylonReplaySource() = default;
+    ~pylonReplaySource() override;
+    pylonReplaySource(const pylonReplaySource&) = delete;
+    pylonReplaySource& operator=(const pylonReplaySource&) = delete;
+
+    // Maps the recording and indexes its records, a truncated last record is dropped
+    bool open(const std::string& path, bool loop);
+    void close();
+    size_t frameCount() const;
+    // Header of the first frame, to size the pipeline before the replay starts
+    const pylonRecording::recordHeader& firstRecord() const;
+
+    bool startGrabbing() override;
+    void stopGrabbing() override;
+    bool isGrabbing() const override;
+    bool retrieveFrame(unsigned int timeout_ms, pylonFrame& frame) override;
+    double tickPeriod() const override;
+
+   private:
+    const pylonRecording::recordHeader& record(size_t index) const;
+
+    const std::uint8_t* m_data{nullptr};
+    size_t m_size{0};
+    double m_tickPeriod{1e-9};
+    std::vector<size_t> m_records;  // offset of every record
+    bool m_loop{true};
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_stopped;
+    bool m_grabbing{false};
+    size_t m_next{0};
+    // The frame m_next is due at m_playbackStart plus its host time minus m_playbackBase
+    std::chrono::steady_clock::time_point m_playbackStart;
+    double m_playbackBase{0.0};
+    std::uint64_t m_timestampOffset{0};  // added at every loop
+};
+
+#endif  // PYLON_REPLAY_SOURCE_H
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#include "pylonRuntime.h"
+
+#include <yarp/os/LogComponent.h>
+#include <yarp/os/Time.h>
+
+namespace
+{
+YARP_LOG_COMPONENT(PYLON_CAMERA, "yarp.device.pylonCamera")
+}
+
+std::shared_ptr<pylonRuntime> pylonRuntime::acquire()
+{
+    // Never destroyed, only initialized and terminated by the references
+    static pylonRuntime runtime;
+    std::lock_guard<std::mutex> guard(runtime.m_referencesMutex);
+    if (runtime.m_references++ == 0)
+    {
+        yCDebug(PYLON_CAMERA) << "Initializing the pylon runtime";
+        Pylon::PylonInitialize();
+    }
+    return std::shared_ptr<pylonRuntime>(&runtime, [](pylonRuntime* released) { released->release(); });
+}
+
+void pylonRuntime::release()
+{
+    std::lock_guard<std::mutex> guard(m_referencesMutex);
+    if (--m_references > 0)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> devices_guard(m_devicesMutex);
+        m_devices.clear();
+        m_enumerated = false;
+    }
+    yCDebug(PYLON_CAMERA) << "Terminating the pylon runtime";
+    Pylon::PylonTerminate();
+}
+
+Pylon::IPylonDevice* pylonRuntime::createDevice(const Pylon::String_t& serial_number)
+{
+    Pylon::CDeviceInfo info;
+    bool found{false};
+    {
+        // The opens running in parallel wait for a single enumeration
+        std::lock_guard<std::mutex> guard(m_devicesMutex);
+        found = findDevice(serial_number, info);
+        if (!found)
+        {
+            enumerateDevices();
+            found = findDevice(serial_number, info);
+        }
+    }
+    if (!found)
+    {
+        // Pylon reports the missing device with its own error
+        yCWarning(PYLON_CAMERA) << "Camera" << serial_number << "not found among the enumerated devices";
+        info.SetSerialNumber(serial_number);
+    }
+    return Pylon::CTlFactory::GetInstance().CreateDevice(info);
+}
+
+bool pylonRuntime::isAvailable(const Pylon::String_t& serial_number)
+{
+    Pylon::CDeviceInfo info;
+    std::lock_guard<std::mutex> guard(m_devicesMutex);
+    enumerateDevices();
+    return findDevice(serial_number, info);
+}
+
+bool pylonRuntime::findDevice(const Pylon::String_t& serial_number, Pylon::CDeviceInfo& info) const
+{
+    for (const auto& device : m_devices)
+    {
+        if (device.GetSerialNumber() == serial_number)
+        {
+            info = device;
+            return true;
+        }
+    }
+    return false;
+}
+
+void pylonRuntime::enumerateDevices()
+{
+    double start = yarp::os::Time::now();
+    m_devices.clear();
+    Pylon::CTlFactory::GetInstance().EnumerateDevices(m_devices);
+    yCDebug(PYLON_CAMERA) << (m_enumerated ? "Enumerated again" : "Enumerated") << m_devices.size() << "devices in" << yarp::os::Time::now() - start << "s";
+    m_enumerated = true;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef PYLON_RUNTIME_H
+#define PYLON_RUNTIME_H
+
+#include <pylon/PylonIncludes.h>
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+/**
+ * \brief Pylon runtime shared by all the devices of the process.
+ *
+ * PylonInitialize() is called by the first acquire() and PylonTerminate() when
+ * the last reference is released, closing a device does not tear the runtime
+ * down under the others. The transport layers are enumerated once and the list
+ * is shared: a device is created from its cached info without enumerating
+ * again, the list is refreshed only when a serial number is not in it (e.g. a
+ * camera plugged later) or when a removed camera is looked for again. It is
+ * thread safe, the devices can be opened in parallel.
+ */
+class pylonRuntime
+{
+   public:
+    // The runtime stays initialized as long as the returned reference is alive
+    static std::shared_ptr<pylonRuntime> acquire();
+
+    pylonRuntime(const pylonRuntime&) = delete;
+    pylonRuntime& operator=(const pylonRuntime&) = delete;
+
+    // Creates the device with the given serial number, throws the pylon exceptions (e.g. no such device)
+    Pylon::IPylonDevice* createDevice(const Pylon::String_t& serial_number);
+    // Enumerates the devices again (e.g. after a removal, the cached info is stale), true if the serial number is among them
+    bool isAvailable(const Pylon::String_t& serial_number);
+
+   private:
+    pylonRuntime() = default;
+    void release();
+    // Cached info of the device, guarded by m_devicesMutex
+    bool findDevice(const Pylon::String_t& serial_number, Pylon::CDeviceInfo& info) const;
+    void enumerateDevices();
+
+    std::mutex m_referencesMutex;
+    size_t m_references{0};
+
+    std::mutex m_devicesMutex;
+    Pylon::DeviceInfoList_t m_devices;
+    bool m_enumerated{false};
+};
+
+#endif  // PYLON_RUNTIME_H
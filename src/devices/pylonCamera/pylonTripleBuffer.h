@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef PYLON_TRIPLE_BUFFER_H
+#define PYLON_TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * \brief Lock-free single-producer/single-consumer triple buffer.
+ *
+ * The producer always owns one slot (writeBuffer()), the consumer always owns
+ * another one (readBuffer()) and the third one is the "middle" slot that holds
+ * the newest published value. publish() and update() just exchange the index of
+ * the owned slot with the middle one, so neither side ever waits for the other
+ * and the consumer always sees the most recent complete value.
+ */
+template <class T>
+class pylonTripleBuffer
+{
+   public:
+    pylonTripleBuffer() = default;
+    pylonTripleBuffer(const pylonTripleBuffer&) = delete;
+    pylonTripleBuffer& operator=(const pylonTripleBuffer&) = delete;
+
+    // Producer side: the slot that can be filled without synchronization.
+    T& writeBuffer()
+    {
+        return m_buffers[m_writeIndex];
+    }
+
+    // Producer side: make the write slot the newest value and get a new write slot.
+    void publish()
+    {
+        auto previous = m_middle.exchange(static_cast<std::uint8_t>(m_writeIndex | m_freshBit), std::memory_order_acq_rel);
+        m_writeIndex = previous & m_indexMask;
+    }
+
+    // Consumer side: fetch the newest value, if any. Returns true if readBuffer() changed.
+    bool update()
+    {
+        if ((m_middle.load(std::memory_order_acquire) & m_freshBit) == 0)
+        {
+            return false;
+        }
+        auto previous = m_middle.exchange(m_readIndex, std::memory_order_acq_rel);
+        m_readIndex = previous & m_indexMask;
+        return true;
+    }
+
+    // Consumer side: the slot returned by the last update().
+    T& readBuffer()
+    {
+        return m_buffers[m_readIndex];
+    }
+
+    // Direct access to the slots, only allowed while neither side is running (e.g. preallocation).
+    std::array<T, 3>& buffers()
+    {
+        return m_buffers;
+    }
+
+   private:
+    static constexpr std::uint8_t m_indexMask{0x3};
+    static constexpr std::uint8_t m_freshBit{0x4};
+
+    std::array<T, 3> m_buffers;
+    std::uint8_t m_writeIndex{0};
+    std::uint8_t m_readIndex{1};
+    std::atomic<std::uint8_t> m_middle{2};
+};
+
+#endif  // PYLON_TRIPLE_BUFFER_H
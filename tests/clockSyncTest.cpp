@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2006-2022 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+// Unit test of pylonClockSync on synthetic camera and host timestamps: the host time of a frame is the
+// camera one with a known offset and drift, plus a random non-negative latency (jitter).
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "pylonClockSync.h"
+
+namespace
+{
+constexpr double tickPeriod{1e-9};  // ns counter, as the USB cameras
+constexpr double framePeriod{0.01};  // s
+
+struct syntheticClock
+{
+    std::uint64_t firstTicks;
+    double hostOffset;  // s, host time of the first tick
+    double drift;
+    double meanLatency;  // s, exponential jitter
+
+    // Host time of the frame taken at the given camera tick value, without the latency
+    double trueHostTime(std::uint64_t ticks) const
+    {
+        return hostOffset + static_cast<double>(ticks - firstTicks) * tickPeriod * (1.0 + drift);
+    }
+};
+
+int failures{0};
+
+void check(bool condition, const char* name, double value, double limit)
+{
+    printf("%-48s %12.3e (limit %.1e) %s\n", name, value, limit, condition ? "ok" : "FAILED");
+    if (!condition)
+    {
+        ++failures;
+    }
+}
+
+// Feeds the given seconds of frames and returns the largest mapping error over the last ones
+double feed(pylonClockSync& sync, const syntheticClock& clock, std::uint64_t& ticks, double seconds, double checked_seconds, std::mt19937& generator)
+{
+    std::exponential_distribution<double> latency(1.0 / clock.meanLatency);
+    auto frames = static_cast<int>(seconds / framePeriod);
+    auto checked_from = frames - static_cast<int>(checked_seconds / framePeriod);
+    double max_error{0.0};
+    for (int i = 0; i < frames; ++i)
+    {
+        ticks += static_cast<std::uint64_t>(framePeriod / tickPeriod);
+        sync.addSample(ticks, clock.trueHostTime(ticks) + latency(generator));
+        if (i >= checked_from)
+        {
+            max_error = std::max(max_error, std::abs(sync.toHostTime(ticks) - clock.trueHostTime(ticks)));
+        }
+    }
+    return max_error;
+}
+
+void testOffsetDriftJitter()
+{
+    std::mt19937 generator(42);
+    syntheticClock clock{123456789000ULL, 1.7e9, 20e-6, 300e-6};
+    pylonClockSync sync(tickPeriod);
+    check(!sync.isValid(), "not valid before the first sample", 0.0, 0.0);
+    auto ticks = clock.firstTicks;
+    // Well past the window, the drift is estimated over its whole baseline
+    auto error = feed(sync, clock, ticks, 300.0, 60.0, generator);
+    check(sync.isValid(), "valid after the samples", 0.0, 0.0);
+    check(error < 20e-6, "mapping error with drift and jitter (s)", error, 20e-6);
+    check(std::abs(sync.drift() - clock.drift) < 1e-7, "drift error", std::abs(sync.drift() - clock.drift), 1e-7);
+    // Mapped ahead of the last sample, the drift keeps the extrapolation close
+    auto ahead = ticks + static_cast<std::uint64_t>(10.0 / tickPeriod);
+    auto ahead_error = std::abs(sync.toHostTime(ahead) - clock.trueHostTime(ahead));
+    check(ahead_error < 20e-6, "mapping error 10 s after the last sample (s)", ahead_error, 20e-6);
+}
+
+void testCounterReset()
+{
+    std::mt19937 generator(7);
+    syntheticClock clock{500000000000ULL, 1.7e9, -35e-6, 200e-6};
+    pylonClockSync sync(tickPeriod);
+    auto ticks = clock.firstTicks;
+    feed(sync, clock, ticks, 60.0, 0.0, generator);
+    // The camera restarted: the counter goes back and the host offset changes
+    syntheticClock restarted{1000ULL, clock.trueHostTime(ticks) + 5.0, clock.drift, clock.meanLatency};
+    ticks = restarted.firstTicks;
+    auto error = feed(sync, restarted, ticks, 60.0, 10.0, generator);
+    check(error < 20e-6, "mapping error after a counter reset (s)", error, 20e-6);
+    // A host clock slower than the camera one, the best sample of each bucket is its last
+    check(std::abs(sync.drift() - clock.drift) < 1e-7, "negative drift error", std::abs(sync.drift() - clock.drift), 1e-7);
+}
+
+void testNoJitter()
+{
+    std::mt19937 generator(1);
+    syntheticClock clock{0ULL, 1.7e9, 5e-6, 1e-12};
+    pylonClockSync sync(tickPeriod);
+    auto ticks = clock.firstTicks;
+    auto error = feed(sync, clock, ticks, 150.0, 100.0, generator);
+    check(error < 2e-6, "mapping error without jitter (s)", error, 2e-6);
+}
+}  // namespace
+
+int main()
+{
+    testOffsetDriftJitter();
+    testCounterReset();
+    testNoJitter();
+    if (failures > 0)
+    {
+        printf("FAILED: %d checks\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("PASSED\n");
+    return EXIT_SUCCESS;
+}